@@ -0,0 +1,106 @@
+/**
+ * @file MPR121_Await
+ * @brief C++20のコルーチンによるタッチイベントの待機
+ * @details MPR121Manager::nextEvent()をco_awaitすると、update()の判定で次にイベントが発生するまでコルーチンを中断する。
+ *          判定処理のみを使う場合（MPR121Detector）は、detect()の判定が対象となる。
+ *          isTouched()をループで確認する代わりに、タッチ・リリースの順序に沿った処理（長押し・ダブルタップなど）を
+ *          そのまま上から下へ書くことができる。コルーチンに対応したコンパイラ（ホスト、ESP32など）でのみ有効となる。
+ *
+ * @section 使い方
+ *    MPR121Task watchPort(MPR121Manager& mpr121) {
+ *      for (;;) {
+ *        MPR121Event touch = co_await mpr121.nextEvent(3);   // ポート3の次のイベントまで中断
+ *        if (touch.type != MPR121Event::TOUCH) continue;
+ *        MPR121Event release = co_await mpr121.nextEvent(3);
+ *        if (release.time - touch.time > 1000000) Serial.println("long press");
+ *      }
+ *    }
+ *
+ *    watchPort(mpr121);   // 最初のco_awaitまで実行して戻る
+ *    mpr121.update();     // loop()内で呼ぶ。発生したイベントを待っているコルーチンはupdate()の最後で再開される
+ *
+ * @section 動作
+ * - update()（replay()）の判定で発生したイベントは、待機中のコルーチンがある場合のみイベントキューに積まれ、
+ *    判定の完了後に発生順に取り出して、そのポート（またはanyPort）を待っているコルーチンを待機開始順に再開する。
+ *    再開したコルーチンが再びnextEvent()を待つと、同じupdate()内で後に発生したイベントも受け取る。
+ * - 待機していない間に発生したイベントは保持しない（co_awaitした時点以降のイベントのみを受け取る）。
+ * - 待機の情報（MPR121EventAwaiter）はコルーチンのフレーム内に置かれるため、co_awaitごとの動的確保は発生しない。
+ *    フレーム自体はコルーチンの開始時に1回だけ確保される。
+ * - 中断中のコルーチンを破棄した場合は、待機も自動的に取り消される。
+ * - 基板の切断・再キャリブレーション・replay()の再開始でタッチが解除された場合も、待機中のコルーチンは
+ *    RELEASE（仮タッチ中はTOUCH_CANCEL）を受け取る。リリースを待ったまま取り残されることはない。
+ * - MPR121Taskは呼び出し元がハンドルを保持しないため、MPR121Managerは待機させたコルーチンより長く存在させること。
+ *    先にMPR121Managerを破棄した場合、待機は取り消され、コルーチンは再開されずに中断したまま残る（フレームは解放されない）。
+ * - ESP32（arduino-esp32）では、ビルドフラグに -std=gnu++2a（GCC 10では -fcoroutines も）を指定する。
+ */
+
+// インクルードガード
+#ifndef MPR121_AWAIT_H
+#define MPR121_AWAIT_H
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define MPR121_COROUTINE 1
+#endif
+#endif
+
+#ifdef MPR121_COROUTINE
+
+#include <coroutine>
+#include <exception>
+#include "MPR121_Event.h"  // タッチイベント
+
+class MPR121Detector;
+
+//*****************************************************************************************************************************
+// タッチイベントの待機（nextEvent()の戻り値をco_awaitする）
+class MPR121EventAwaiter {
+public:
+  static const uint8_t anyPort = 0xFF;  // 全ポートのイベントを待つ
+
+  MPR121EventAwaiter(MPR121Detector& setDetector, uint8_t setPort)
+    : detector(setDetector), port(setPort) {}
+  MPR121EventAwaiter(const MPR121EventAwaiter&) = delete;
+  MPR121EventAwaiter& operator=(const MPR121EventAwaiter&) = delete;
+  ~MPR121EventAwaiter();  // 待機中に破棄された場合は待機を取り消す
+
+  bool await_ready() const noexcept {
+    return false;
+  }
+  void await_suspend(std::coroutine_handle<> setHandle) noexcept;  // 待機を登録して中断
+  MPR121Event await_resume() const noexcept {
+    return event;
+  }
+
+private:
+  friend class MPR121Detector;
+  MPR121Detector& detector;             // 待機先の判定処理
+  uint8_t port;                         // 待機するポート番号（anyPortで全ポート）
+  bool waiting = false;                 // 待機中か
+  MPR121Event event = {};               // 受け取ったイベント
+  std::coroutine_handle<> handle;       // 再開するコルーチン
+  MPR121EventAwaiter* next = nullptr;   // 次の待機（待機開始順の連結リスト）
+};
+
+//*****************************************************************************************************************************
+// 戻り値を使用しないコルーチンの型（呼び出し元は待たず、最後まで実行するとフレームを解放する）
+struct MPR121Task {
+  struct promise_type {
+    MPR121Task get_return_object() noexcept {
+      return {};
+    }
+    std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+    std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+};
+
+#endif
+#endif
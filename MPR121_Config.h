@@ -1,108 +1,232 @@
-/**
- * @file MPR121
- * @brief 静電センサー制御
- * @details 静電センサー基板の詳細設定を決めて、制御管理を行うシステム
- * @date 2025/5/7
- * @author 株式会社SIVAX 先進技術開発室　森田
- *
- * @section 製作環境
- * - Arduino IDE ver 2.3.6
- *
- * @section I2Cアドレスの変更方法
- * - 基盤上のADDRポートを以下のポートとショートさせることでハード的に変更する
- *    ADDR - GND -> 0x5A（デフォルト）
- *    ADDR - VDD -> 0x5B
- *    ADDR - SDA -> 0x5C
- *    ADDR - SCL -> 0X5D
- *
- * @section パラメータ調整の影響
- * - alpha（平滑化係数）
- *    値が1.0に近づくほど新しい値に敏感になり、0.0に近づくほど過去の値に引っ張られる。
- *    値を大きくすると反応は速くなるがノイズの影響も受けやすくなる。
- *    値を小さくするとノイズに強くなるが反応が鈍くなる。
- *
- * - minValue（センサー値の下限値）
- *    キャリブレーションや環境変化に対応するために定める。
- *    値を適切に維持しないと誤検出の原因となる。
- *
- * - maxValue（センサー値の上限値）
- *    感度やノイズの許容範囲を見極める基準として定める。
- *
- * - touchMargin[]（タッチ閾値調整量）
- *    タッチを検出する際のしきい値の調整量。
- *    値を大きくすると確実なタッチのみを検出するようになるが、軽いタッチでは反応しにくくなる。
- *    値を小さくすると軽いタッチでも反応するが、ノイズによる誤検出が増える可能性がある。
- *
- * - releaseMargin（リリース閾値調整量）
- *    リリース（タッチ解除）を検出する際のしきい値の調整量。
- *    値を小さくするとすぐにリリース判定が出やすくなり、反応性は上がるが不安定になりやすい。
- *    値を大きくすると安定するが、タッチが離された後もしばらく押されているように誤判定されることがある。
- *
- * - touchJuge（タッチ判定の検知回数）
- *    タッチとして確定するまでに連続して何回検出されたかのしきい値。
- *    値を大きくするとタッチ判定が安定するが、反応は遅くなる。
- *    値を小さくすると即応性が上がるが、誤検出が起こりやすくなる。
- *
- * - releaseJuge（リリース判定の検知回数）
- *    リリースとして確定するまでに連続して何回検出されたかのしきい値。
- *    値を大きくするとリリース判定が安定するが、離したと認識されるまで時間がかかる。
- *    値を小さくすると即応性が上がるが、誤ってリリース判定されやすくなる。
- *
- * @section メモ
- * - 電源立ち上げ時に静電センサーの対象物には触れないこと
- * - 誤検出を防止する為に、タッチ調整量（touchMargin）はリリース調整量（releaseMargin）よりも大きくすること
- * - 判定に関わるパラメータはマイコンの処理速度を考慮して調整すること
- */
-
-// インクルードガード
-#ifndef MPR121_CONFIG_H
-#define MPR121_CONFIG_H
-
-#include <Arduino.h>          // Arduinoライブラリ
-#include <Wire.h>             // I2Cライブラリ
-#include <Adafruit_MPR121.h>  // 静電モジュールライブラリ
-#include <vector>
-
-using namespace std;  // 名前空間を指定
-
-//*****************************************************************************************************************************
-// 静電センサー管理クラス
-class MPR121Manager {
-  // 外部からのアクセスを許可
-public:
-  MPR121Manager(uint8_t setAddress = 0x5A, uint16_t usedPortMask = 0xFFFF);                 // コンストラクタ
-  void update();                                                                            // 状態を更新
-  void printStatus(uint32_t interval, const vector<String>& portLabel = vector<String>());  // 状態の表示
-  bool isTouched(uint8_t port);                                                             // 特定ピンがタッチ中か判定
-  void setTouchMargin(uint8_t port, uint8_t margin);                                        // タッチ判定用マージンを設定
-  void setReleaseMargin(uint8_t port, uint8_t margin);                                      // リリース判定用マージンを設定
-  void setSensorMinValue(uint8_t port, uint16_t value);                                     // 指定ポートの下限値を設定
-  void setSensorMaxValue(uint8_t port, uint16_t value);                                     // 指定ポートの上限値を設定
-  void setTouchJugeCount(uint8_t port, uint8_t count);                                      // タッチ判定回数を設定
-  void setReleaseJugeCount(uint8_t port, uint8_t count);                                    // リリース判定回数を設定
-
-  // 自クラス内部のみアクセス許可
-private:
-  // センサー基板管理
-  Adafruit_MPR121 cap;                // 制御インスタンス
-  static const uint8_t maxPort = 12;  // 基板上の接続可能ポート数
-  uint16_t activePort;                // 使用ポートのビットマスク
-  uint8_t address;                    // I2Cアドレス
-
-  // センサー数値管理
-  float value[maxPort];        // 各ポートのセンサー値
-  const float alpha = 0.6;     // 平滑化係数
-  uint16_t minValue[maxPort];  // センサー値の下限値
-  uint16_t maxValue[maxPort];  // センサー値の上限値
-
-  // 判定管理
-  uint16_t currentTouched = 0;      // タッチ状態をビットで格納
-  uint8_t counter[maxPort];         // タッチ／リリース検知用カウンタ
-  float threshold[maxPort];         // 閾値
-  uint16_t touchMargin[maxPort];    // タッチ閾値調整量
-  uint16_t releaseMargin[maxPort];  // リリース閾値調整量
-  uint8_t touchJuge[maxPort];       // タッチ判定の検知回数
-  uint8_t releaseJuge[maxPort];     // リリース判定の検知回数
-};
-
-#endif
+/**
+ * @file MPR121
+ * @brief 静電センサー制御
+ * @details 静電センサー基板の詳細設定を決めて、制御管理を行うシステム
+ * @date 2025/5/7
+ * @author 株式会社SIVAX 先進技術開発室　森田
+ *
+ * @section 製作環境
+ * - Arduino IDE ver 2.3.6
+ *
+ * @section I2Cアドレスの変更方法
+ * - 基盤上のADDRポートを以下のポートとショートさせることでハード的に変更する
+ *    ADDR - GND -> 0x5A（デフォルト）
+ *    ADDR - VDD -> 0x5B
+ *    ADDR - SDA -> 0x5C
+ *    ADDR - SCL -> 0X5D
+ *
+ * @section パラメータ調整の影響
+ * - alpha（平滑化係数）
+ *    値が1.0に近づくほど新しい値に敏感になり、0.0に近づくほど過去の値に引っ張られる。
+ *    値を大きくすると反応は速くなるがノイズの影響も受けやすくなる。
+ *    値を小さくするとノイズに強くなるが反応が鈍くなる。setAlpha()で変更できる。
+ *
+ * - minValue（センサー値の下限値）
+ *    キャリブレーションや環境変化に対応するために定める。
+ *    値を適切に維持しないと誤検出の原因となる。
+ *
+ * - maxValue（センサー値の上限値）
+ *    感度やノイズの許容範囲を見極める基準として定める。
+ *
+ * - touchMargin[]（タッチ閾値調整量）
+ *    タッチを検出する際のしきい値の調整量。
+ *    値を大きくすると確実なタッチのみを検出するようになるが、軽いタッチでは反応しにくくなる。
+ *    値を小さくすると軽いタッチでも反応するが、ノイズによる誤検出が増える可能性がある。
+ *
+ * - releaseMargin（リリース閾値調整量）
+ *    リリース（タッチ解除）を検出する際のしきい値の調整量。
+ *    値を小さくするとすぐにリリース判定が出やすくなり、反応性は上がるが不安定になりやすい。
+ *    値を大きくすると安定するが、タッチが離された後もしばらく押されているように誤判定されることがある。
+ *
+ * - touchJuge（タッチ判定の検知回数）
+ *    タッチとして確定するまでに連続して何回検出されたかのしきい値。
+ *    値を大きくするとタッチ判定が安定するが、反応は遅くなる。
+ *    値を小さくすると即応性が上がるが、誤検出が起こりやすくなる。
+ *
+ * - releaseJuge（リリース判定の検知回数）
+ *    リリースとして確定するまでに連続して何回検出されたかのしきい値。
+ *    値を大きくするとリリース判定が安定するが、離したと認識されるまで時間がかかる。
+ *    値を小さくすると即応性が上がるが、誤ってリリース判定されやすくなる。
+ *
+ * - detectMode（判定方式）
+ *    DETECT_FILTERED : 平滑化したセンサー値と、確定時に固定した閾値で判定する（従来方式）。
+ *    DETECT_BASELINE : チップが保持するベースライン値との差分（ベースライン − 計測値）で判定する。
+ *                      ドリフト追従はチップ側で行われるため、minValue／maxValueによる制限は使用しない。
+ *
+ * - statusInterval（異常状態の確認間隔）
+ *    何回のupdate()ごとに範囲外（OOR）／過電流の状態レジスタを確認するか。
+ *    異常を検出した場合はその基板のみ自動キャリブレーションをやり直し、再設定中は判定を停止する。
+ *    やり直しても範囲外のままのポートは、範囲内に戻るまで判定から外し、他のポートの判定はそのまま続ける。
+ *    値を小さくすると異常からの復帰が早くなるが、I2Cの転送量が増える。0で確認を行わない。
+ *
+ * - setAutoConfigLimit(supplyVoltage, targetRatio)（自動キャリブレーションの充電目標）
+ *    電源電圧から自動キャリブレーションの上限(USL)・下限(LSL)・目標(TL)を計算して書き込む（AN3889準拠）。
+ *      USL = (Vdd - 0.7) / Vdd × 256、 TL = USL × targetRatio、 LSL = USL × 0.65
+ *    基板の電源電圧に合わせることで感度が上がり、touchJuge／releaseJugeを小さくしやすくなる。
+ *    未設定の場合はチップの初期値のまま動作する。
+ *
+ * - 基板の抜き差し
+ *    読み出しがfailLimit回連続で失敗した基板は未接続として扱い、全ポートをリリース状態にする。
+ *    未接続の基板は読み出しを行わず、probeMinInterval～probeMaxInterval[ms]の間で間隔を倍々に延ばしながら応答を確認し、
+ *    応答が戻った時点で基板を初期化して判定を再開する。他の基板の更新周期には影響しない。
+ *
+ * - タッチ強度（getStrength／getStrengthSnapshot）
+ *    非タッチ時の基準値からの下がり幅をtouchMarginで正規化した符号付き値（256でタッチ閾値と同じ深さ）。
+ *    update()の判定処理の中で計算されるため、取得時にI2C通信は発生しない。
+ *
+ * - マトリクス（キーパッド）モード（setMatrix）
+ *    行電極N本と列電極M本を交差させ、1つのキーが行・列の2電極に同時に触れる配置でN×M個のキーを判定する。
+ *    複数の行と複数の列が同時にタッチされた場合は、行と列のタッチ強度の合計が最大の組み合わせのみを押下とする（ゴースト防止）。
+ *    キー番号は keyMap[行 × M + 列] で指定する（省略時は 行 × M + 列）。
+ *
+ * - releaseRatio[]（動的ヒステリシスの復帰率）
+ *    タッチ中のセンサー値の最小値を記録し、基準値からの深さに対する割合[%]でリリース閾値を決める。
+ *      リリース閾値 = 最小値 + 深さ × releaseRatio / 100（ただしreleaseMargin以上）
+ *    ゆっくり触れた場合でも触れ切った深さに合わせて閾値が決まるため、releaseJugeを小さくしてもチャタリングしにくい。
+ *    0で無効（タッチ確定時の値 + releaseMarginで固定）。
+ *
+ * - predictSlope[]（先行タッチ検出の傾き）
+ *    リリース中にセンサー値が1回あたりこの値以上下がり、次回には閾値を下回る見込みの場合に仮タッチ（TOUCH_BEGIN）を出力する。
+ *    touchJuge回の確定を待たずに反応できるため、確定時にTOUCH、閾値を下回らずに下降が止まった場合はTOUCH_CANCELを出力する。
+ *    値を小さくすると早く反応するが取り消しが増える。0で無効。
+ *
+ * - oversample（オーバーサンプリング回数）
+ *    1回のupdate()で計測値を何回連続して読み出し、平均するか。I2Cの転送量と引き換えにノイズを抑える。
+ *    チップの計測周期（ESI）より短い間隔で読み出しても同じ値になるため、I2C速度とポート数に合わせて調整すること。
+ *
+ * - decimation（判定の間引き率）
+ *    平滑化は毎回のupdate()で行い、タッチ／リリースの判定は何回に1回行うか。
+ *    touchJuge／releaseJugeは判定の回数で数えるため、間引き率を上げた場合は回数を減らすこと。
+ *
+ * - pipeline[]（判定前の処理段）
+ *    計測値 → 平滑化（PIPELINE_FILTER）→ 範囲制限（PIPELINE_CLAMP）→ 判定 のうち、ポートごとに実行する段を選ぶ（初期値は両方）。
+ *    チップのフィルタで十分なポートは平滑化を、範囲制限が不要なポートは範囲制限を外すことで、1スキャンあたりの処理を減らせる。
+ *    DETECT_BASELINEでは指定にかかわらず範囲制限は行わない。
+ *
+ * - 安定したポートの処理の省略
+ *    判定時にセンサー値・傾きが変化せず、判定条件も満たさない（カウンタが0のまま）ポートは、
+ *    計測値（DETECT_BASELINEではベースラインも）が同じである間、平滑化・判定を省略する。結果は省略しない場合と同じになる。
+ *
+ * - 設定データ（saveConfig／loadConfig）
+ *    alpha・touchMargin・releaseMargin・touchJuge・releaseJugeをconfigSizeバイトのデータにまとめて書き出し／読み込みする。
+ *    ホストのパラメータ探索ツール（host/tune_params）が出力した配列をそのままloadConfig()に渡せる。
+ *
+ * - 記録データの再生（replay）
+ *    I2C通信を行わず、与えた計測値でupdate()と同じ平滑化・判定を行う。ホスト上での再生やパラメータ探索に使用する。
+ *
+ * - 判定状態の取得と復元（getPortState／setPortState）
+ *    ポートごとのセンサー値・閾値・カウンタ・タッチ状態を取り出し、別のインスタンスや後の時点に戻す。
+ *    ホストの並列再生（host/ReplayEngine.h）は、ポートごとに一定スキャン数ごとの判定状態をチェックポイントとして記録し、
+ *    setPortState()で任意の区間から再生を再開する（replay_traces --verify 1で再開結果の一致を確認する）。
+ *
+ * - 判定処理（MPR121Detector、MPR121_Core.h）
+ *    平滑化・判定・イベント出力・設定／状態データはArduinoに依存しないヘッダーのみの判定処理にまとめ、
+ *    MPR121Managerはそれに読み出し・接続監視・異常監視・表示を加えたものとしている。
+ *    ホストでの再生など読み出しが不要な場合は、MPR121Detectorに計測値と時刻を直接与えて同じ判定を行える。
+ *
+ * - 外部での一括読み出し（getBurstRange／updateFromBurst）
+ *    update()の読み出し部分を外に出し、複数基板の読み出しを1回の転送にまとめる場合に使用する（LinuxのI2C_RDWRなど）。
+ *    getBurstRange()で得た範囲を読み出してupdateFromBurst()に渡すと、オーバーサンプリング以外はupdate()と同じ処理を行う。
+ *
+ * - タッチイベントの待機（nextEvent、C++20のコルーチンに対応したコンパイラのみ）
+ *    co_await mpr121.nextEvent(port)で、update()の判定で次にイベントが発生するまでコルーチンを中断する（MPR121_Await.h）。
+ *    待機はコルーチンのフレーム内に置かれ、co_awaitごとの動的確保は発生しない。
+ *
+ * - 状態データ（saveState／loadState）
+ *    全使用ポートの判定状態とタッチ状態をstateMaxSizeバイト以内のデータにまとめて書き出し／復元する。
+ *    ウォッチドッグリセット後の再開、ディープスリープ中の保持（ESP32のRTCメモリなど）、ホストでの再生の途中再開に使用する。
+ *    使用ポートと判定方式が書き出し時と異なる場合は復元しない。
+ *
+ * @section メモ
+ * - 電源立ち上げ時に静電センサーの対象物には触れないこと
+ * - 誤検出を防止する為に、タッチ調整量（touchMargin）はリリース調整量（releaseMargin）よりも大きくすること
+ * - 判定に関わるパラメータはマイコンの処理速度を考慮して調整すること
+ */
+
+// インクルードガード
+#ifndef MPR121_CONFIG_H
+#define MPR121_CONFIG_H
+
+#include <Arduino.h>          // Arduinoライブラリ
+#include <Wire.h>             // I2Cライブラリ
+#include <Adafruit_MPR121.h>  // 静電モジュールライブラリ
+#include "MPR121_Core.h"      // 判定処理
+#include "MPR121_Output.h"    // タッチイベント出力
+#include <vector>
+
+using namespace std;  // 名前空間を指定
+
+//*****************************************************************************************************************************
+// 静電センサー管理クラス
+class MPR121Manager : public MPR121Detector {
+  // 外部からのアクセスを許可
+public:
+  MPR121Manager(uint8_t setAddress = 0x5A, uint16_t usedPortMask = 0xFFFF,
+                TwoWire* setWire = &Wire);                                                  // コンストラクタ
+  void update();                                                                            // 状態を更新
+  void printStatus(uint32_t interval, const vector<String>& portLabel = vector<String>());  // 状態の表示
+  void setOversample(uint8_t count);                                                        // オーバーサンプリング回数を設定
+  void replay(const uint16_t* filtered, const uint16_t* baselineData = nullptr,
+              bool restart = false);                                                        // 記録した計測値で状態を更新（I2C通信なし）
+  bool getBurstRange(uint8_t& reg, uint8_t& length);                                        // 次回の更新で読み出すレジスタ範囲を取得
+  void updateFromBurst(const uint8_t* buffer, bool received);                               // 外部で読み出したレジスタ値で状態を更新
+  static bool calcAutoConfigLimit(float supplyVoltage, float targetRatio,
+                                  uint8_t& usl, uint8_t& lsl, uint8_t& tl);                 // 充電目標レジスタ値を計算
+  void setStatusCheckInterval(uint16_t interval);                                           // 異常状態の確認間隔を設定
+  bool setAutoConfigLimit(float supplyVoltage, float targetRatio = 0.9);                    // 自動キャリブレーションの充電目標を設定
+  uint16_t getFaultPort();                                                                  // 範囲外となっているポートを取得
+  bool isOverCurrent();                                                                     // 過電流を検出したか判定
+  bool isConnected();                                                                       // 基板が接続されているか判定
+
+  static const uint8_t burstSize = 43;  // 状態(0x00-0x03)～ベースライン(0x1E-0x2A)の全長
+
+  // 自クラス内部のみアクセス許可
+private:
+  // センサー基板管理
+  Adafruit_MPR121 cap;     // 制御インスタンス
+  TwoWire* wire;           // 接続先のI2Cバス
+  uint8_t firstPort;       // 使用ポートの先頭番号
+  uint8_t lastPort;        // 使用ポートの末尾番号
+  uint8_t oversample = 1;  // オーバーサンプリング回数
+
+  // レジスタ一括読み出し
+  static const uint8_t i2cChunk = 32;                                // 1回のI2C読み出しで扱う最大バイト数
+  bool burstStatus = false;                                          // 外部での一括読み出しに状態レジスタを含むか
+  uint8_t burstReg = 0;                                              // 外部での一括読み出しの開始レジスタ
+  bool readRegisters(uint8_t reg, uint8_t* buffer, uint8_t length);  // 連続レジスタを一括で読み出す
+  bool readSensorData(bool withStatus);                              // 計測値（とベースライン・状態）を取得
+  bool burstRange(bool withStatus, uint8_t& start, uint8_t& length); // 一括読み出しするレジスタ範囲を求める
+  void storeSensorData(const uint8_t* buffer, uint8_t start, bool withStatus);  // 読み出した値から計測値を取り出す
+  bool beginUpdate(bool& withStatus);                                // 更新の前処理（再接続・状態確認の判断）
+  void finishUpdate(bool received);                                  // 更新の後処理（接続管理と判定）
+  bool sampleSensorData(bool withStatus);                            // オーバーサンプリングして計測値を取得
+
+  // 異常監視
+  static const uint8_t regOorStatusL = 0x02;  // 範囲外状態レジスタ（下位）
+  static const uint8_t ecrSetting = 0x8C;     // 計測開始時のECR設定値（Adafruitライブラリと同じ）
+  static const uint8_t settleScans = 10;      // 再キャリブレーション後に判定を停止する回数
+  uint8_t autoConfig0 = 0x0B;                 // 自動キャリブレーション設定値
+  uint8_t upperLimit = 0;                     // 自動キャリブレーション上限値（USL、0で未設定）
+  uint8_t lowerLimit = 0;                     // 自動キャリブレーション下限値（LSL）
+  uint8_t targetLevel = 0;                    // 自動キャリブレーション目標値（TL）
+  uint16_t statusInterval = 100;              // 異常状態の確認間隔（update回数）
+  uint16_t statusCounter = 0;                 // 異常状態確認用カウンタ
+  bool overCurrent = false;                   // 過電流検出フラグ
+  uint16_t lastFailure = 0;                   // 前回の状態確認での異常（範囲外ポートと自動キャリブレーション失敗）
+  uint8_t settleCount = 0;                    // 再キャリブレーション完了待ちの残り回数
+  void writeAutoConfig();                     // 自動キャリブレーション設定を書き込んで実行
+  void checkStatus(const uint8_t* status);    // 状態レジスタを確認して必要なら再キャリブレーション
+
+  // 接続監視
+  static const uint8_t failLimit = 3;              // 未接続と判断する連続読み出し失敗回数
+  static const uint16_t probeMinInterval = 10;     // 再接続確認の最短間隔[ms]
+  static const uint16_t probeMaxInterval = 5000;   // 再接続確認の最長間隔[ms]
+  bool connected = true;                           // 接続状態
+  uint8_t failCount = 0;                           // 連続読み出し失敗回数
+  uint16_t probeInterval = probeMinInterval;       // 現在の再接続確認間隔[ms]
+  uint32_t lastProbeTime = 0;                      // 前回の再接続確認時刻[ms]
+  void disconnect();                               // 未接続状態に移行
+  bool probe();                                    // 再接続を確認して初期化
+};
+
+#endif
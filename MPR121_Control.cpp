@@ -1,251 +1,527 @@
-
-#include "MPR121_Config.h"
-
-//*****************************************************************************************************************************
-/**
- * @brief コンストラクタ
- * @param address 基板のI2Cアドレスを指定
- * @param usedPortMask 使用するポート番号を任意で指定
- */
-//*****************************************************************************************************************************
-MPR121Manager::MPR121Manager(uint8_t setAddress, uint16_t usedPortMask) {
-  cap.begin(setAddress);
-
-  // 自動キャリブレーションを有効にする
-  cap.writeRegister(MPR121_AUTOCONFIG0, 0x0B);
-
-  // 使用ポートマスクを保存（ビット単位）
-  activePort = usedPortMask;
-
-  // アドレスを保存
-  address = setAddress;
-
-  // 設定待機
-  delay(100);
-
-  // 各ポートの初期化
-  for (uint8_t i = 0; i < maxPort; i++) {
-    if ((activePort >> i) & 1) {
-      // センサー値範囲の初期設定
-      minValue[i] = 600;
-      maxValue[i] = 710;
-
-      // センサー値を取得
-      value[i] = cap.filteredData(i);
-      value[i] = constrain(value[i], minValue[i], maxValue[i]);
-
-      // 判定変数の初期設定
-      touchMargin[i] = 30;    // タッチマージン
-      releaseMargin[i] = 20;  // リリースマージン
-      touchJuge[i] = 15;      // タッチ判定の回数閾値
-      releaseJuge[i] = 15;    // リリース判定の回数閾値
-      counter[i] = 0;         // カウンターを初期化
-
-      // 初回の閾値を設定
-      threshold[i] = value[i] - touchMargin[i];
-    }
-  }
-}
-
-//*****************************************************************************************************************************
-/**
- * @brief センサーの状態を更新する
- */
-//*****************************************************************************************************************************
-void MPR121Manager::update() {
-  for (uint8_t i = 0; i < maxPort; ++i) {
-    if ((activePort >> i) & 1) {
-
-      // センサーの生値を取得して平滑化
-      uint16_t raw = cap.filteredData(i);
-      value[i] = alpha * raw + (1.0 - alpha) * value[i];
-      value[i] = constrain(value[i], minValue[i], maxValue[i]);
-
-      // 現在のタッチ状態（ビットで取得）
-      bool touched = (currentTouched >> i) & 1;
-
-      // 判定条件（状態に応じて比較方向を変える）
-      bool conditionMet = touched
-                            ? (value[i] > threshold[i])   // タッチ中：値がしきい値より上 → リリース
-                            : (value[i] < threshold[i]);  // リリース中：値がしきい値より下 → タッチ
-
-      // 判定結果に応じてカウンター処理
-      if (conditionMet) {
-        counter[i]++;
-      } else {
-        counter[i] = 0;
-      }
-
-      // カウンターが規定値に達したら状態を反転
-      if ((!touched && counter[i] > touchJuge[i]) || (touched && counter[i] > releaseJuge[i])) {
-
-        currentTouched ^= (1 << i);  // 状態を反転
-        counter[i] = 0;
-
-        // 状態に応じて次のしきい値を固定
-        if (touched) {
-          // リリース直後：タッチ状態に戻るための基準値を下げて設定
-          threshold[i] = value[i] - touchMargin[i];
-        } else {
-          // タッチ直後：リリース判定の基準値を上げて設定
-          threshold[i] = value[i] + releaseMargin[i];
-        }
-      }
-    }
-  }
-}
-
-//*****************************************************************************************************************************
-/**
- * @brief 指定されたポートのタッチ状態を返す
- * @param port 対象のポート番号
- */
-//*****************************************************************************************************************************
-bool MPR121Manager::isTouched(uint8_t port) {
-  if (port < maxPort && (activePort & (1 << port))) {
-    bool touched = (currentTouched >> port) & 1;
-    return touched;
-  } else return false;
-}
-
-//*****************************************************************************************************************************
-/**
- * @brief コンストラクタ
- * @param interval 表示間隔
- */
-//*****************************************************************************************************************************
-void MPR121Manager::printStatus(uint32_t interval, const vector<String>& portLabel) {
-  static uint32_t lastPrintTime = millis();
-  uint32_t currentTime = millis();
-
-  if (currentTime - lastPrintTime < interval) return;
-  lastPrintTime = currentTime;
-
-  Serial.print("Add: 0x");
-  Serial.print(address, HEX);
-  Serial.print(" ->");
-
-  uint8_t labelIndex = 0;  // ラベル表示用のインデックス（使う場合のみ）
-
-  for (uint8_t i = 0; i < maxPort; ++i) {
-    if ((activePort >> i) & 1) {
-      bool touched = (currentTouched >> i) & 1;
-
-      Serial.print("  |  ");
-
-      // ラベルがある場合 → labelIndex使用
-      // ない場合 → i（実ポート番号）使用
-      if (labelIndex < portLabel.size()) {
-        Serial.print(portLabel[labelIndex]);
-        labelIndex++;  // アクティブな順の表示番号を進める
-      } else {
-        Serial.print("Port ");
-        Serial.print(i);  // 実ポート番号で表示
-      }
-
-      Serial.print(": ");
-      Serial.print(touched ? "Touch" : "Release");
-      Serial.print("  Val: ");
-      Serial.print(value[i], 2);
-      Serial.print("  Thr: ");
-      Serial.print(threshold[i], 2);
-      Serial.print("  Raw: ");
-      Serial.print(cap.filteredData(i));
-    }
-  }
-  Serial.println();
-}
-
-//*****************************************************************************************************************************
-/**
- * @brief 指定ポートのタッチ判定マージンを設定する
- * @param port 対象のポート番号
- * @param margin 設定するマージン値
- */
-//*****************************************************************************************************************************
-void MPR121Manager::setTouchMargin(uint8_t port, uint8_t margin) {
-  if (port < maxPort && (activePort & (1 << port))) {
-    touchMargin[port] = margin;
-
-    // 状態に応じて次のしきい値を固定
-    bool touched = (currentTouched >> port) & 1;
-    if (touched) {
-      threshold[port] = value[port] + releaseMargin[port];
-    } else {
-      threshold[port] = value[port] - touchMargin[port];
-    }
-  }
-}
-
-//*****************************************************************************************************************************
-/**
- * @brief 指定ポートのリリース判定マージンを設定する
- * @param port 対象のポート番号
- * @param margin 設定するマージン値
- */
-//*****************************************************************************************************************************
-void MPR121Manager::setReleaseMargin(uint8_t port, uint8_t margin) {
-  if (port < maxPort && (activePort & (1 << port))) {
-    releaseMargin[port] = margin;
-
-    // 状態に応じて次のしきい値を固定
-    bool touched = (currentTouched >> port) & 1;
-    if (touched) {
-      threshold[port] = value[port] + releaseMargin[port];
-    } else {
-      threshold[port] = value[port] - touchMargin[port];
-    }
-  }
-}
-
-//*****************************************************************************************************************************
-/**
- * @brief 指定ポートのセンサー下限値を設定する
- * @param port 対象のポート番号
- * @param value 設定する下限値（500以上の値を推奨）
- */
-//*****************************************************************************************************************************
-void MPR121Manager::setSensorMinValue(uint8_t port, uint16_t value) {
-  if (port < maxPort && (activePort & (1 << port))) {
-    minValue[port] = value;
-  }
-}
-
-//*****************************************************************************************************************************
-/**
- * @brief 指定ポートのセンサー上限値を設定する
- * @param port 対象のポート番号
- * @param value 設定する上限値（720以下の値を推奨）
- */
-//*****************************************************************************************************************************
-void MPR121Manager::setSensorMaxValue(uint8_t port, uint16_t value) {
-  if (port < maxPort && (activePort & (1 << port))) {
-    maxValue[port] = value;
-  }
-}
-
-//*****************************************************************************************************************************
-/**
- * @brief 指定ポートのタッチ判定に必要な連続回数を設定する
- * @param port 対象のポート番号
- * @param count 判定に必要な回数（10以上の値を推奨）
- */
-//*****************************************************************************************************************************
-void MPR121Manager::setTouchJugeCount(uint8_t port, uint8_t count) {
-  if (port < maxPort && (activePort & (1 << port))) {
-    touchJuge[port] = count;
-  }
-}
-
-//*****************************************************************************************************************************
-/**
- * @brief 指定ポートのリリース判定に必要な連続回数を設定する
- * @param port 対象のポート番号
- * @param count 判定に必要な回数（10以上の値を推奨）
- */
-//*****************************************************************************************************************************
-void MPR121Manager::setReleaseJugeCount(uint8_t port, uint8_t count) {
-  if (port < maxPort && (activePort & (1 << port))) {
-    releaseJuge[port] = count;
-  }
-}
+
+#include "MPR121_Config.h"
+
+//*****************************************************************************************************************************
+/**
+ * @brief コンストラクタ
+ * @param address 基板のI2Cアドレスを指定
+ * @param usedPortMask 使用するポート番号を任意で指定
+ * @param setWire 基板を接続したI2Cバス（省略時はWire）
+ */
+//*****************************************************************************************************************************
+MPR121Manager::MPR121Manager(uint8_t setAddress, uint16_t usedPortMask, TwoWire* setWire)
+  : MPR121Detector(usedPortMask, setAddress) {
+  // 接続先のI2Cバスを保存
+  wire = setWire;
+
+  // 起動時に応答がない場合は未接続として扱い、update()内で再接続を待つ
+  connected = cap.begin(setAddress, wire);
+  lastProbeTime = millis();
+
+  // 自動キャリブレーションを有効にする
+  writeAutoConfig();
+
+  // 使用ポートの範囲を求める（一括読み出しの範囲に使用）
+  firstPort = maxPort;
+  lastPort = 0;
+  for (uint8_t i = 0; i < maxPort; i++) {
+    if ((activePort >> i) & 1) {
+      if (firstPort == maxPort) firstPort = i;
+      lastPort = i;
+    }
+  }
+
+  // 設定待機
+  delay(100);
+
+  // 各ポートのセンサー値を取得して初回の閾値を設定
+  uint16_t filtered[maxPort] = {};
+  uint16_t baselineData[maxPort] = {};
+  for (uint8_t i = 0; i < maxPort; i++) {
+    if ((activePort >> i) & 1) {
+      filtered[i] = cap.filteredData(i);
+      baselineData[i] = cap.baselineData(i);
+    }
+  }
+  begin(filtered, baselineData);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief センサーの状態を更新する
+ */
+//*****************************************************************************************************************************
+void MPR121Manager::update() {
+  bool withStatus;
+  if (!beginUpdate(withStatus)) return;
+
+  // 使用ポートの計測値を一括で取得
+  finishUpdate(sampleSensorData(withStatus));
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 次回の更新で読み出すレジスタ範囲を取得する（複数基板の読み出しを外部でまとめる場合に使用）
+ * @param reg 読み出し開始レジスタ
+ * @param length 読み出すバイト数（burstSize以下）
+ * @return 読み出しが必要な場合true（未接続で再接続できない場合はfalse、updateFromBurst()は呼ばないこと）
+ * @details 呼び出すたびに状態レジスタの確認間隔を数えるため、update()の代わりに1回の更新につき1回だけ呼ぶこと
+ */
+//*****************************************************************************************************************************
+bool MPR121Manager::getBurstRange(uint8_t& reg, uint8_t& length) {
+  if (!beginUpdate(burstStatus)) return false;
+  if (!burstRange(burstStatus, reg, length)) return false;
+  burstReg = reg;
+  return true;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 外部で読み出したレジスタ値で状態を更新する
+ * @param buffer getBurstRange()の範囲を読み出した値
+ * @param received 読み出しに成功した場合true（falseの場合は読み出し失敗として数える）
+ * @details オーバーサンプリングは行わない。それ以外はupdate()と同じく接続・異常監視と判定を行う
+ */
+//*****************************************************************************************************************************
+void MPR121Manager::updateFromBurst(const uint8_t* buffer, bool received) {
+  if (received) storeSensorData(buffer, burstReg, burstStatus);
+  finishUpdate(received);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 更新の前処理（再接続の確認と、状態レジスタを読み出すかの判断）
+ * @param withStatus 今回状態レジスタも読み出す場合true
+ * @return 読み出しを行う場合true
+ */
+//*****************************************************************************************************************************
+bool MPR121Manager::beginUpdate(bool& withStatus) {
+  // 未接続の基板は再接続の確認のみ行う
+  if (!connected && !probe()) return false;
+
+  // 一定回数ごとに状態レジスタも合わせて読み出す
+  withStatus = false;
+  if (statusInterval > 0 && ++statusCounter >= statusInterval) {
+    statusCounter = 0;
+    withStatus = true;
+  }
+  return true;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 更新の後処理（読み出し結果に応じて接続状態を管理し、判定を行う）
+ * @param received 計測値を取得できた場合true
+ */
+//*****************************************************************************************************************************
+void MPR121Manager::finishUpdate(bool received) {
+  // 取得できなければ状態を維持し、連続で失敗したら未接続とする
+  if (!received) {
+    if (++failCount >= failLimit) disconnect();
+    return;
+  }
+  failCount = 0;
+
+  // 再キャリブレーション中は判定を行わず、完了後に閾値を取り直す
+  if (settleCount > 0) {
+    if (--settleCount == 0) {
+      eventTime = micros();
+      restartDetection();
+    }
+    return;
+  }
+
+  processSensorData(micros());
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 記録した計測値を与えて状態を更新する（I2C通信なし）
+ * @param filtered 各ポートの計測値（ポート番号順に12個）
+ * @param baselineData 各ポートのベースライン値（10bit換算、12個）。nullptrの場合は前回の値を維持
+ * @param restart trueの場合は判定状態を初期化し、この計測値から閾値を取り直す
+ * @details ホスト上での記録データの再生やパラメータ探索に使用する。接続監視・異常監視は行わない。
+ */
+//*****************************************************************************************************************************
+void MPR121Manager::replay(const uint16_t* filtered, const uint16_t* baselineData, bool restart) {
+  if (restart) {
+    settleCount = 0;
+    eventTime = micros();
+    MPR121Detector::restart(filtered, baselineData);
+    return;
+  }
+
+  detect(micros(), filtered, baselineData);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 連続したレジスタを一括で読み出す
+ * @param reg 読み出し開始レジスタ
+ * @param buffer 読み出し先バッファ
+ * @param length 読み出すバイト数
+ * @return 読み出しに成功した場合true
+ */
+//*****************************************************************************************************************************
+bool MPR121Manager::readRegisters(uint8_t reg, uint8_t* buffer, uint8_t length) {
+  while (length > 0) {
+    // I2Cバッファに収まる長さに分割して読み出す
+    uint8_t chunk = (length > i2cChunk) ? i2cChunk : length;
+
+    wire->beginTransmission(address);
+    wire->write(reg);
+    if (wire->endTransmission(false) != 0) return false;
+    if (wire->requestFrom(address, chunk) != chunk) return false;
+
+    for (uint8_t n = 0; n < chunk; n++) {
+      *buffer++ = wire->read();
+    }
+    reg += chunk;
+    length -= chunk;
+  }
+  return true;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 使用ポートの計測値（ベースライン判定時はベースラインも）を1回の連続読み出しで取得する
+ * @param withStatus trueの場合はタッチ／範囲外状態レジスタも読み出して異常を確認する
+ * @return 取得に成功した場合true
+ */
+//*****************************************************************************************************************************
+bool MPR121Manager::readSensorData(bool withStatus) {
+  uint8_t buffer[burstSize];
+  uint8_t start, length;
+  if (!burstRange(withStatus, start, length)) return false;
+  if (!readRegisters(start, buffer, length)) return false;
+  storeSensorData(buffer, start, withStatus);
+  return true;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 一括読み出しするレジスタ範囲を求める
+ * @param withStatus trueの場合はタッチ／範囲外状態レジスタから読み出す
+ * @param start 読み出し開始レジスタ
+ * @param length 読み出すバイト数
+ * @return 使用ポートがある場合true
+ */
+//*****************************************************************************************************************************
+bool MPR121Manager::burstRange(bool withStatus, uint8_t& start, uint8_t& length) {
+  if (firstPort > lastPort) return false;
+
+  // 状態(0x00-0x03)・計測値(0x04-0x1D)・ベースライン(0x1E-0x2A)は連続しているため、必要な範囲をまとめて読み出す
+  start = withStatus ? MPR121_TOUCHSTATUS_L : (MPR121_FILTDATA_0L + firstPort * 2);
+  uint8_t end = (detectMode == DETECT_BASELINE) ? (MPR121_BASELINE_0 + lastPort)
+                                                : (MPR121_FILTDATA_0L + lastPort * 2 + 1);
+  length = end - start + 1;
+  return true;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 一括読み出しした値から計測値（とベースライン・状態）を取り出す
+ * @param buffer 読み出した値
+ * @param start 読み出し開始レジスタ
+ * @param withStatus trueの場合は状態レジスタを確認する
+ */
+//*****************************************************************************************************************************
+void MPR121Manager::storeSensorData(const uint8_t* buffer, uint8_t start, bool withStatus) {
+  for (uint8_t i = firstPort; i <= lastPort; ++i) {
+    const uint8_t* data = &buffer[MPR121_FILTDATA_0L + i * 2 - start];
+    rawData[i] = (data[0] | (data[1] << 8)) & 0x03FF;  // 10bit値
+
+    // ベースラインは上位8bitのみ保持されているため10bitに換算
+    if (detectMode == DETECT_BASELINE) {
+      baseline[i] = buffer[MPR121_BASELINE_0 + i - start] << 2;
+    }
+  }
+
+  if (withStatus) checkStatus(buffer);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 設定回数だけ計測値を連続して読み出し、平均した値をrawDataに格納する
+ * @param withStatus trueの場合は1回目の読み出しで状態レジスタも確認する
+ * @return 全ての読み出しに成功した場合true
+ */
+//*****************************************************************************************************************************
+bool MPR121Manager::sampleSensorData(bool withStatus) {
+  if (!readSensorData(withStatus)) return false;
+  if (oversample <= 1) return true;
+
+  // 2回目以降は計測値（とベースライン）のみ読み出して合計
+  uint16_t sum[maxPort];
+  for (uint8_t i = firstPort; i <= lastPort; ++i) sum[i] = rawData[i];
+  for (uint8_t n = 1; n < oversample; ++n) {
+    if (!readSensorData(false)) return false;
+    for (uint8_t i = firstPort; i <= lastPort; ++i) sum[i] += rawData[i];
+  }
+
+  // 四捨五入して平均
+  for (uint8_t i = firstPort; i <= lastPort; ++i) {
+    rawData[i] = (sum[i] + oversample / 2) / oversample;
+  }
+  return true;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 状態レジスタ(0x00-0x03)を確認し、範囲外／過電流があればこの基板のみ再キャリブレーションする
+ * @param status 状態レジスタの読み出し値（4バイト）
+ * @details 再設定中の待機はsettleCountで管理するため、他の基板の更新は停止しない。
+ *          再キャリブレーションは過電流か、前回の確認から異常が新たに発生した場合のみ行う。
+ *          やり直しても範囲外のままのポートは判定から外したまま、基板を再起動せずに他のポートの判定を続ける。
+ */
+//*****************************************************************************************************************************
+void MPR121Manager::checkStatus(const uint8_t* status) {
+  // 過電流フラグ（TOUCHSTATUS_Hのbit7）：検出時は計測が停止しているため、フラグを解除して計測を再開
+  overCurrent = status[1] & 0x80;
+  if (overCurrent) {
+    cap.writeRegister(MPR121_TOUCHSTATUS_H, 0x80);
+    cap.writeRegister(MPR121_ECR, ecrSetting);
+  }
+
+  // 範囲外状態（bit0-11：各電極、OORSTATUS_Hのbit7：自動キャリブレーション失敗）
+  uint16_t oor = status[regOorStatusL] | (status[regOorStatusL + 1] << 8);
+  uint16_t failure = oor & (0x8000 | (activePort & 0x0FFF));
+  uint16_t recovered = faultPort & ~failure;
+  faultPort = failure & 0x0FFF;
+
+  // 範囲外から戻ったポートは、そのポートのみ閾値を取り直して判定を再開
+  for (uint8_t i = 0; i < maxPort; ++i) {
+    if ((recovered >> i) & 1) restartPort(i);
+  }
+
+  // 過電流または新たな異常がある場合のみ自動キャリブレーションをやり直す
+  bool newFailure = failure & ~lastFailure;
+  lastFailure = failure;
+  if (overCurrent || newFailure) {
+    writeAutoConfig();
+    settleCount = settleScans;
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 未接続状態に移行し、全ポートをリリース状態にする
+ * @details タッチ中・仮タッチ中のポートは、リリース・仮タッチ取り消しのイベントを出力してから解除する
+ */
+//*****************************************************************************************************************************
+void MPR121Manager::disconnect() {
+  connected = false;
+  failCount = 0;
+  eventTime = micros();
+  releaseAll();
+  faultPort = 0;
+  lastFailure = 0;
+  settleCount = 0;
+  idlePort = 0;
+  for (uint8_t i = 0; i < maxPort; ++i) {
+    strength[i] = 0;
+  }
+
+  // 再接続確認は最短間隔から開始
+  probeInterval = probeMinInterval;
+  lastProbeTime = millis();
+
+  // 解除のイベントを待っているコルーチンを再開
+  dispatchEvents();
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 未接続の基板の応答を確認し、応答があれば初期化して判定を再開する
+ * @return 再接続できた場合true
+ * @details 応答がない場合は確認間隔を倍にしていき、未接続の基板がI2Cを占有しないようにする
+ */
+//*****************************************************************************************************************************
+bool MPR121Manager::probe() {
+  uint32_t currentTime = millis();
+  if (currentTime - lastProbeTime < probeInterval) return false;
+  lastProbeTime = currentTime;
+
+  // アドレスのみ送信してACKを確認
+  wire->beginTransmission(address);
+  if (wire->endTransmission() != 0) {
+    probeInterval = (probeInterval > probeMaxInterval / 2) ? probeMaxInterval : probeInterval * 2;
+    return false;
+  }
+
+  // 電源が入り直しているためリセットから設定し直す
+  if (!cap.begin(address, wire)) return false;
+  writeAutoConfig();
+
+  // 自動キャリブレーション完了後に閾値を取り直す
+  connected = true;
+  failCount = 0;
+  statusCounter = 0;
+  settleCount = settleScans;
+  return true;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 自動キャリブレーションの設定を書き込む
+ * @details レジスタ書き込み時に停止→再開されるため、書き込むたびに自動キャリブレーションが実行される
+ */
+//*****************************************************************************************************************************
+void MPR121Manager::writeAutoConfig() {
+  // 充電目標が設定されている場合は先に書き込む
+  if (upperLimit != 0) {
+    cap.writeRegister(MPR121_UPLIMIT, upperLimit);
+    cap.writeRegister(MPR121_LOWLIMIT, lowerLimit);
+    cap.writeRegister(MPR121_TARGETLIMIT, targetLevel);
+  }
+  cap.writeRegister(MPR121_AUTOCONFIG0, autoConfig0);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief コンストラクタ
+ * @param interval 表示間隔
+ */
+//*****************************************************************************************************************************
+void MPR121Manager::printStatus(uint32_t interval, const vector<String>& portLabel) {
+  static uint32_t lastPrintTime = millis();
+  uint32_t currentTime = millis();
+
+  if (currentTime - lastPrintTime < interval) return;
+  lastPrintTime = currentTime;
+
+  Serial.print("Add: 0x");
+  Serial.print(address, HEX);
+  Serial.print(" ->");
+
+  uint8_t labelIndex = 0;  // ラベル表示用のインデックス（使う場合のみ）
+
+  for (uint8_t i = 0; i < maxPort; ++i) {
+    if ((activePort >> i) & 1) {
+      bool touched = (currentTouched >> i) & 1;
+
+      Serial.print("  |  ");
+
+      // ラベルがある場合 → labelIndex使用
+      // ない場合 → i（実ポート番号）使用
+      if (labelIndex < portLabel.size()) {
+        Serial.print(portLabel[labelIndex]);
+        labelIndex++;  // アクティブな順の表示番号を進める
+      } else {
+        Serial.print("Port ");
+        Serial.print(i);  // 実ポート番号で表示
+      }
+
+      Serial.print(": ");
+      Serial.print(touched ? "Touch" : "Release");
+      Serial.print("  Val: ");
+      Serial.print(value[i], 2);
+      Serial.print("  Thr: ");
+      Serial.print(threshold[i], 2);
+      Serial.print("  Raw: ");
+      Serial.print(rawData[i]);
+      if (detectMode == DETECT_BASELINE) {
+        Serial.print("  Base: ");
+        Serial.print(baseline[i]);
+      }
+    }
+  }
+  Serial.println();
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 1回のupdate()で計測値を読み出して平均する回数を設定する
+ * @param count 読み出し回数（1～16、1でオーバーサンプリングなし）
+ */
+//*****************************************************************************************************************************
+void MPR121Manager::setOversample(uint8_t count) {
+  oversample = constrain(count, 1, 16);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 範囲外／過電流の状態確認を行う間隔を設定する
+ * @param interval 確認間隔（update回数、0で確認しない）
+ */
+//*****************************************************************************************************************************
+void MPR121Manager::setStatusCheckInterval(uint16_t interval) {
+  statusInterval = interval;
+  statusCounter = 0;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 電源電圧から自動キャリブレーションの充電目標を計算して書き込む
+ * @param supplyVoltage 基板の電源電圧[V]（1.71～3.6V）
+ * @param targetRatio 上限値に対する目標値の比率（0.65～1.0、推奨0.9）
+ * @return 設定できた場合true
+ * @details 書き込み後は自動キャリブレーションが再実行されるため、完了まで判定を停止する
+ */
+//*****************************************************************************************************************************
+bool MPR121Manager::setAutoConfigLimit(float supplyVoltage, float targetRatio) {
+  uint8_t usl, lsl, tl;
+  if (!calcAutoConfigLimit(supplyVoltage, targetRatio, usl, lsl, tl)) return false;
+
+  upperLimit = usl;
+  lowerLimit = lsl;
+  targetLevel = tl;
+
+  writeAutoConfig();
+  settleCount = settleScans;
+  return true;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 電源電圧から自動キャリブレーションの上限・下限・目標レジスタ値を計算する（AN3889）
+ * @param supplyVoltage 基板の電源電圧[V]（1.71～3.6V）
+ * @param targetRatio 上限値に対する目標値の比率（0.65～1.0）
+ * @param usl 上限値（USL）の格納先
+ * @param lsl 下限値（LSL）の格納先
+ * @param tl 目標値（TL）の格納先
+ * @return 引数が範囲内で計算できた場合true
+ */
+//*****************************************************************************************************************************
+bool MPR121Manager::calcAutoConfigLimit(float supplyVoltage, float targetRatio, uint8_t& usl, uint8_t& lsl, uint8_t& tl) {
+  if (supplyVoltage < 1.71 || supplyVoltage > 3.6) return false;
+  if (targetRatio < 0.65 || targetRatio > 1.0) return false;
+
+  // 充電電圧の上限は電源電圧から0.7V下げた値
+  float upper = (supplyVoltage - 0.7) / supplyVoltage * 256.0;
+  if (upper > 255.0) upper = 255.0;
+
+  usl = (uint8_t)upper;
+  tl = (uint8_t)(upper * targetRatio);
+  lsl = (uint8_t)(upper * 0.65);
+  return true;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 直近の状態確認で範囲外となっていたポートを返す
+ * @return 範囲外ポートのビットマスク
+ */
+//*****************************************************************************************************************************
+uint16_t MPR121Manager::getFaultPort() {
+  return faultPort;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 直近の状態確認で過電流を検出していたかを返す
+ */
+//*****************************************************************************************************************************
+bool MPR121Manager::isOverCurrent() {
+  return overCurrent;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 基板が接続されているかを返す
+ */
+//*****************************************************************************************************************************
+bool MPR121Manager::isConnected() {
+  return connected;
+}
+
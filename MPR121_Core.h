@@ -0,0 +1,1369 @@
+/**
+ * @file MPR121_Core
+ * @brief 静電センサーの判定処理（ヘッダーのみ・動的確保なし）
+ * @details 計測値の平滑化・範囲制限、タッチ／リリース判定、仮タッチ、タッチ強度、マトリクス、設定・状態データを行う判定部分。
+ *          Arduinoの型（String、Serial、millis、constrainなど）やstd::vectorに依存せず、標準Cのヘッダー（stdint.h・stddef.h・string.h）のみで
+ *          コンパイルできるため、マイコン・ホストのツール・記録データの再生で同じ処理をそのまま使用できる。
+ *
+ * @section 環境との分担
+ * - 時刻：detect()の引数で与える（イベントの発生時刻となる）。判定処理から時刻を読み出すことはない。
+ * - バス：判定処理は読み出しを行わず、読み出した計測値（とベースライン）を受け取る。
+ *    MPR121ManagerはTwoWire（ホストではI2CBus）から読み出して渡す。
+ * - 出力：タッチイベントはMPR121EventSink、またはコルーチン（nextEvent）へ渡す。ログ・表示は使用側で行う。
+ * - 状態は全て固定長の配列で保持し、判定中に動的確保は発生しない。
+ *
+ * @section 使い方（判定処理のみを使う場合）
+ *    MPR121Detector detector(0x0FFF);
+ *    detector.begin(filtered, baseline);        // 最初の計測値から閾値を決める（ポート番号順に12個）
+ *    detector.detect(now, filtered, baseline);  // スキャンごとに計測値を与えて判定
+ *    detector.isTouched(3);
+ */
+
+// インクルードガード
+#ifndef MPR121_CORE_H
+#define MPR121_CORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "MPR121_Event.h"  // タッチイベント
+#include "MPR121_Await.h"  // タッチイベントの待機（コルーチン）
+
+//*****************************************************************************************************************************
+// 1ポート分の判定状態（getPortState／setPortStateで使用）
+struct MPR121PortState {
+  float value;       // センサー値
+  float lastValue;   // 前回判定時のセンサー値
+  float threshold;   // 閾値
+  float reference;   // 非タッチ時の基準値
+  float peakValue;   // タッチ中のセンサー値の最小値
+  float peakSlope;   // 判定中の最大変化量
+  int16_t strength;  // タッチ強度
+  uint8_t counter;   // タッチ／リリース検知用カウンタ
+  bool touched;      // タッチ状態
+  bool provisional;  // 仮タッチ状態
+
+  bool operator==(const MPR121PortState& other) const {
+    return value == other.value && lastValue == other.lastValue && threshold == other.threshold
+           && reference == other.reference && peakValue == other.peakValue && peakSlope == other.peakSlope
+           && strength == other.strength && counter == other.counter && touched == other.touched
+           && provisional == other.provisional;
+  }
+  bool operator!=(const MPR121PortState& other) const {
+    return !(*this == other);
+  }
+};
+
+//*****************************************************************************************************************************
+// 判定処理（読み出しを行わず、与えられた計測値でタッチ／リリースを判定する）
+class MPR121Detector {
+  // 外部からのアクセスを許可
+public:
+  // 判定方式
+  enum DetectMode : uint8_t {
+    DETECT_FILTERED = 0,  // 平滑化値と固定閾値で判定
+    DETECT_BASELINE,      // チップのベースラインとの差分で判定
+  };
+
+  // 判定前の処理段（setPipelineで組み合わせて指定）
+  enum PipelineStage : uint8_t {
+    PIPELINE_RAW = 0x00,     // 計測値をそのまま判定
+    PIPELINE_FILTER = 0x01,  // 平滑化（alpha）
+    PIPELINE_CLAMP = 0x02,   // 範囲制限（minValue～maxValue）
+  };
+
+  MPR121Detector(uint16_t usedPortMask = 0xFFFF, uint8_t setAddress = 0x5A);                // コンストラクタ
+#ifdef MPR121_COROUTINE
+  ~MPR121Detector();                                                                        // デストラクタ（待機中のコルーチンの待機を取り消す）
+#endif
+  void begin(const uint16_t* filtered, const uint16_t* baselineData = nullptr);             // 最初の計測値から判定を開始
+  void detect(uint32_t now, const uint16_t* filtered, const uint16_t* baselineData = nullptr);  // 計測値を与えて判定
+  void restart(const uint16_t* filtered, const uint16_t* baselineData = nullptr);           // 判定状態を初期化して閾値を取り直す
+  bool isTouched(uint8_t port);                                                             // 特定ピンがタッチ中か判定
+  bool isTouchBegun(uint8_t port);                                                          // 特定ピンが仮タッチまたはタッチ中か判定
+  int16_t getStrength(uint8_t port);                                                        // 特定ピンのタッチ強度を取得
+  uint8_t getStrengthSnapshot(int16_t* buffer);                                             // 使用ポートのタッチ強度を詰めて取得
+  uint8_t getRawSnapshot(uint16_t* buffer);                                                 // 使用ポートの計測値を詰めて取得
+  uint16_t getTouchedPorts();                                                               // タッチ中のポートをビットで取得
+  uint16_t getDetectingPorts();                                                             // タッチ中・判定途中のポートをビットで取得
+  uint16_t getPortMask();                                                                   // 使用ポートのビットマスクを取得
+  uint8_t getAddress();                                                                     // 基板のI2Cアドレスを取得
+  bool getPortState(uint8_t port, MPR121PortState& state);                                  // 特定ピンの判定状態を取得
+  void setPortState(uint8_t port, const MPR121PortState& state);                            // 特定ピンの判定状態を復元
+  bool setMatrix(const uint8_t* rowPort, uint8_t rows,
+                 const uint8_t* colPort, uint8_t cols, const uint8_t* keyMap = nullptr);    // マトリクスモードを設定
+  void clearMatrix();                                                                       // マトリクスモードを解除
+  bool isKeyPressed(uint8_t key);                                                           // マトリクスのキーが押下中か判定
+  uint64_t getPressedKeys();                                                                // マトリクスの押下キーを取得
+  void setEventSink(MPR121EventSink* sink);                                                 // タッチイベントの出力先を設定
+#ifdef MPR121_COROUTINE
+  MPR121EventAwaiter nextEvent(uint8_t port = MPR121EventAwaiter::anyPort);                 // 次のタッチイベントを待つ（co_await）
+#endif
+  void setDetectMode(uint8_t mode);                                                         // 判定方式を設定
+  void setTouchMargin(uint8_t port, uint8_t margin);                                        // タッチ判定用マージンを設定
+  void setReleaseMargin(uint8_t port, uint8_t margin);                                      // リリース判定用マージンを設定
+  void setSensorMinValue(uint8_t port, uint16_t value);                                     // 指定ポートの下限値を設定
+  void setSensorMaxValue(uint8_t port, uint16_t value);                                     // 指定ポートの上限値を設定
+  void setTouchJugeCount(uint8_t port, uint8_t count);                                      // タッチ判定回数を設定
+  void setReleaseJugeCount(uint8_t port, uint8_t count);                                    // リリース判定回数を設定
+  void setReleaseRatio(uint8_t port, uint8_t ratio);                                        // 動的ヒステリシスの復帰率を設定
+  void setPredictSlope(uint8_t port, uint8_t slope);                                        // 先行タッチ検出の傾きを設定
+  void setPipeline(uint8_t port, uint8_t stages);                                           // 判定前に行う処理段を設定
+  void setDecimation(uint8_t factor);                                                       // 判定の間引き率を設定
+  void setAlpha(float setAlpha);                                                            // 平滑化係数を設定
+  size_t saveConfig(uint8_t* buffer, size_t size);                                          // 判定パラメータを設定データに書き出す
+  bool loadConfig(const uint8_t* buffer, size_t size);                                      // 設定データから判定パラメータを読み込む
+  size_t saveState(uint8_t* buffer, size_t size);                                           // 判定状態を状態データに書き出す
+  bool loadState(const uint8_t* buffer, size_t size);                                       // 状態データから判定状態を復元
+
+  static const uint8_t configVersion = 1;     // 設定データの形式バージョン
+  static const uint8_t configSize = 53;       // 設定データのサイズ（ヘッダー4 + 12ポート × 4 + チェックサム1）
+  static const uint8_t stateVersion = 1;      // 状態データの形式バージョン
+  static const uint8_t stateHeaderSize = 19;  // 状態データのヘッダーサイズ
+  static const uint8_t statePortSize = 27;    // 状態データの1ポートあたりのサイズ
+  static const uint16_t stateMaxSize = 344;   // 全ポート使用時の状態データのサイズ（ヘッダー + 12ポート × 27 + チェックサム1）
+
+  // 派生クラス（MPR121Manager）からのアクセスを許可
+protected:
+  static const uint8_t maxPort = 12;  // 基板上の接続可能ポート数
+
+  // 値を範囲内に制限する（Arduinoのconstrainと同じ比較で、結果はamountの型）
+  template <class T, class L, class H>
+  static T clampValue(T amount, L low, H high) {
+    return amount < low ? (T)low : (amount > high ? (T)high : amount);
+  }
+
+  void storeData(const uint16_t* filtered, const uint16_t* baselineData);  // 与えられた計測値を保持
+
+  // センサー数値管理
+  uint16_t activePort;                   // 使用ポートのビットマスク
+  uint8_t address;                       // I2Cアドレス（イベントに付加）
+  uint8_t detectMode = DETECT_FILTERED;  // 判定方式
+  uint16_t rawData[maxPort];             // 各ポートの計測値（チップのフィルタ後の値）
+  uint16_t baseline[maxPort];            // 各ポートのベースライン値（10bit換算）
+  float value[maxPort];                  // 各ポートのセンサー値
+  float lastValue[maxPort];              // 前回判定時のセンサー値
+  float alpha = 0.6;                     // 平滑化係数
+  uint16_t minValue[maxPort];            // センサー値の下限値
+  uint16_t maxValue[maxPort];            // センサー値の上限値
+  uint8_t pipeline[maxPort];             // 判定前に行う処理段（PipelineStageの組み合わせ）
+  uint8_t decimation = 1;                // 判定の間引き率
+  uint8_t decimationCount = 0;           // 判定間引き用カウンタ
+
+  // 判定管理
+  uint16_t currentTouched = 0;      // タッチ状態をビットで格納
+  uint8_t counter[maxPort];         // タッチ／リリース検知用カウンタ
+  float threshold[maxPort];         // 閾値
+  float reference[maxPort];         // 非タッチ時の基準値
+  int16_t strength[maxPort];        // タッチ強度（256 = タッチ閾値の深さ）
+  float peakSlope[maxPort];         // 判定中に観測した1回あたりの最大変化量（ベロシティ用）
+  uint16_t faultPort = 0;           // 判定しないポート（範囲外となっているポート）のビットマスク
+  void processSensorData(uint32_t now);  // 取得済みの計測値を平滑化して判定
+  void updateThreshold(uint8_t port);    // 状態に応じて閾値を設定
+  void restartDetection();               // 判定状態を初期化して閾値を取り直す
+  void restartPort(uint8_t port);        // 指定ポートの判定状態を初期化して閾値を取り直す
+  void releasePort(uint8_t port);        // 指定ポートをリリース状態にする（イベントを出力）
+  void releaseAll();                     // 全ポートをリリース状態にする（イベントを出力）
+  uint16_t touchMargin[maxPort];    // タッチ閾値調整量
+  uint16_t releaseMargin[maxPort];  // リリース閾値調整量
+  uint8_t touchJuge[maxPort];       // タッチ判定の検知回数
+  uint8_t releaseJuge[maxPort];     // リリース判定の検知回数
+  uint8_t releaseRatio[maxPort];    // 動的ヒステリシスの復帰率[%]（0で無効）
+  float peakValue[maxPort];         // タッチ中のセンサー値の最小値
+  uint8_t predictSlope[maxPort];    // 先行タッチ検出の傾き（0で無効）
+  uint16_t provisionalTouched = 0;  // 仮タッチ状態をビットで格納
+  uint16_t idlePort = 0;            // 処理を省略できる安定したポートのビットマスク
+  uint16_t idleRaw[maxPort];        // 省略を始めた時点の計測値
+  uint16_t idleBaseline[maxPort];   // 省略を始めた時点のベースライン値
+  void predictTouch(uint8_t port, float slope);  // 傾きから仮タッチを判定
+
+  // イベント出力
+  MPR121EventSink* eventSink = nullptr;                     // タッチイベントの出力先
+  uint32_t eventTime = 0;                                   // 判定中のイベントの発生時刻[us]
+  void emitEvent(uint8_t port, uint8_t type, float slope);  // タッチイベントを出力
+  bool hasEventOutput();                                    // イベントの出力先（待機中のコルーチンを含む）があるか
+  void dispatchEvents();                                    // 判定中に発生したイベントを待機中のコルーチンに渡す
+#ifdef MPR121_COROUTINE
+  friend class MPR121EventAwaiter;
+  static const uint8_t eventQueueSize = 2 * maxPort;        // 1回の判定で発生しうるイベント数（仮タッチ＋確定）
+  MPR121Event eventQueue[eventQueueSize];                   // 待機中のコルーチンに渡すイベント
+  uint8_t eventHead = 0;                                    // イベントキューの先頭
+  uint8_t eventCount = 0;                                   // イベントキューの件数
+  MPR121EventAwaiter* awaiters = nullptr;                   // 待機中のコルーチン（待機開始順）
+  MPR121EventAwaiter* resuming = nullptr;                   // 再開待ちのコルーチン
+  void addAwaiter(MPR121EventAwaiter* awaiter);             // 待機を登録
+  void removeAwaiter(MPR121EventAwaiter* awaiter);          // 待機を取り消す
+  void resumeAwaiters();                                    // キューのイベントを待機中のコルーチンに渡して再開
+#endif
+
+  // マトリクス管理
+  static const uint8_t maxMatrixKey = 36;  // 最大キー数（6行 × 6列）
+  uint8_t matrixRows = 0;                  // 行電極数（0でマトリクスモード無効）
+  uint8_t matrixCols = 0;                  // 列電極数
+  uint8_t matrixRow[maxPort];              // 行電極のポート番号
+  uint8_t matrixCol[maxPort];              // 列電極のポート番号
+  uint8_t matrixKey[maxMatrixKey];         // 行・列に対応するキー番号
+  uint64_t pressedKeys = 0;                // 押下中のキーをビットで格納
+  void decodeMatrix();                     // 行・列のタッチ状態からキーを判定
+};
+
+//*****************************************************************************************************************************
+/**
+ * @brief コンストラクタ
+ * @param usedPortMask 使用するポート番号を任意で指定
+ * @param setAddress イベントに付加する基板のI2Cアドレス
+ * @details 判定パラメータを初期値に設定する。判定はbegin()で最初の計測値を与えてから開始する
+ */
+//*****************************************************************************************************************************
+inline MPR121Detector::MPR121Detector(uint16_t usedPortMask, uint8_t setAddress) {
+  activePort = usedPortMask;
+  address = setAddress;
+
+  for (uint8_t i = 0; i < maxPort; i++) {
+    // センサー値範囲の初期設定
+    minValue[i] = 600;
+    maxValue[i] = 710;
+
+    // 判定変数の初期設定
+    touchMargin[i] = 30;    // タッチマージン
+    releaseMargin[i] = 20;  // リリースマージン
+    touchJuge[i] = 15;      // タッチ判定の回数閾値
+    releaseJuge[i] = 15;    // リリース判定の回数閾値
+    releaseRatio[i] = 0;    // 動的ヒステリシスは無効
+    predictSlope[i] = 0;    // 先行タッチ検出は無効
+    pipeline[i] = PIPELINE_FILTER | PIPELINE_CLAMP;  // 平滑化・範囲制限を行う
+    counter[i] = 0;         // カウンターを初期化
+    strength[i] = 0;        // タッチ強度を初期化
+    peakSlope[i] = 0;       // 最大変化量を初期化
+    rawData[i] = 0;
+    baseline[i] = 0;
+    value[i] = 0;
+    lastValue[i] = 0;
+    reference[i] = 0;
+    peakValue[i] = 0;
+    threshold[i] = 0;
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 最初の計測値から各ポートの基準値と閾値を決め、判定を開始する
+ * @param filtered 各ポートの計測値（ポート番号順に12個）
+ * @param baselineData 各ポートのベースライン値（10bit換算、12個）。nullptrの場合は0
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::begin(const uint16_t* filtered, const uint16_t* baselineData) {
+  storeData(filtered, baselineData);
+
+  for (uint8_t i = 0; i < maxPort; i++) {
+    if ((activePort >> i) & 1) {
+      value[i] = rawData[i];
+      if (detectMode != DETECT_BASELINE && (pipeline[i] & PIPELINE_CLAMP)) {
+        value[i] = clampValue(value[i], minValue[i], maxValue[i]);
+      }
+
+      // 初回の閾値を設定
+      reference[i] = value[i];
+      peakValue[i] = value[i];
+      lastValue[i] = value[i];
+      threshold[i] = value[i] - touchMargin[i];
+    }
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 計測値を与えてタッチ／リリースを判定する
+ * @param now 判定時刻[us]（発生したイベントの時刻とする）
+ * @param filtered 各ポートの計測値（ポート番号順に12個）
+ * @param baselineData 各ポートのベースライン値（10bit換算、12個）。nullptrの場合は前回の値を維持
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::detect(uint32_t now, const uint16_t* filtered, const uint16_t* baselineData) {
+  storeData(filtered, baselineData);
+  processSensorData(now);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 判定状態を初期化し、与えた計測値から閾値を取り直す
+ * @param filtered 各ポートの計測値（ポート番号順に12個）
+ * @param baselineData 各ポートのベースライン値（10bit換算、12個）。nullptrの場合は前回の値を維持
+ * @details 判定しないポート（faultPort）と間引きのカウントも初期化する。
+ *          タッチ中・仮タッチ中のポートは、直前の判定時刻でリリース・仮タッチ取り消しのイベントを出力してから初期化する
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::restart(const uint16_t* filtered, const uint16_t* baselineData) {
+  storeData(filtered, baselineData);
+  faultPort = 0;
+  decimationCount = 0;
+  restartDetection();
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 与えられた使用ポートの計測値（とベースライン）を保持する
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::storeData(const uint16_t* filtered, const uint16_t* baselineData) {
+  for (uint8_t i = 0; i < maxPort; ++i) {
+    if ((activePort >> i) & 1) {
+      rawData[i] = filtered[i];
+      if (baselineData != nullptr) baseline[i] = baselineData[i];
+    }
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 指定されたポートのタッチ状態を返す
+ * @param port 対象のポート番号
+ */
+//*****************************************************************************************************************************
+inline bool MPR121Detector::isTouched(uint8_t port) {
+  if (port < maxPort && (activePort & (1 << port))) {
+    bool touched = (currentTouched >> port) & 1;
+    return touched;
+  } else return false;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 指定されたポートが仮タッチまたはタッチ中かを返す
+ * @param port 対象のポート番号
+ */
+//*****************************************************************************************************************************
+inline bool MPR121Detector::isTouchBegun(uint8_t port) {
+  if (port < maxPort && (activePort & (1 << port))) {
+    return ((currentTouched | provisionalTouched) >> port) & 1;
+  } else return false;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 指定されたポートのタッチ強度を返す
+ * @param port 対象のポート番号
+ * @return 基準値からの下がり幅をタッチマージンで正規化した値（256でタッチ閾値の深さ、負の値は基準値より上）
+ */
+//*****************************************************************************************************************************
+inline int16_t MPR121Detector::getStrength(uint8_t port) {
+  if (port < maxPort && (activePort & (1 << port))) {
+    return strength[port];
+  } else return 0;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 直近の判定で計算した使用ポートのタッチ強度を、ポート番号順に詰めてコピーする
+ * @param buffer コピー先（使用ポート数以上の要素数が必要）
+ * @return コピーした要素数
+ */
+//*****************************************************************************************************************************
+inline uint8_t MPR121Detector::getStrengthSnapshot(int16_t* buffer) {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < maxPort; ++i) {
+    if ((activePort >> i) & 1) {
+      buffer[count++] = strength[i];
+    }
+  }
+  return count;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 直近の判定に与えた使用ポートの計測値を、ポート番号順に詰めてコピーする
+ * @param buffer コピー先（使用ポート数以上の要素数が必要）
+ * @return コピーした要素数
+ */
+//*****************************************************************************************************************************
+inline uint8_t MPR121Detector::getRawSnapshot(uint16_t* buffer) {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < maxPort; ++i) {
+    if ((activePort >> i) & 1) {
+      buffer[count++] = rawData[i];
+    }
+  }
+  return count;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief タッチ中のポートをビットで返す
+ * @return ポート番号の位置のビットが1になった値
+ */
+//*****************************************************************************************************************************
+inline uint16_t MPR121Detector::getTouchedPorts() {
+  return currentTouched & activePort;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief タッチ中、またはタッチの判定途中のポートをビットで返す
+ * @return タッチ中・仮タッチ中・カウンタが0でない・リリース中にセンサー値（平滑化前の計測値を含む）が閾値を下回っているポートのビットが1になった値
+ * @details 判定の確定には連続した判定が必要なため、更新周期を落とす場合はこの値が0になるまで周期を維持すること。
+ *          平滑化後の値は更新回数に応じてしか追従しないため、周期を落としている間は計測値側で判定の開始を捉える
+ */
+//*****************************************************************************************************************************
+inline uint16_t MPR121Detector::getDetectingPorts() {
+  uint16_t ports = currentTouched | provisionalTouched;
+  for (uint8_t i = 0; i < maxPort; ++i) {
+    if (counter[i] > 0 || value[i] < threshold[i] || rawData[i] < threshold[i]) ports |= (1 << i);
+  }
+  return ports & activePort & ~faultPort;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 使用ポートのビットマスクを返す
+ */
+//*****************************************************************************************************************************
+inline uint16_t MPR121Detector::getPortMask() {
+  return activePort & 0x0FFF;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 基板のI2Cアドレス（イベントに付加するアドレス）を返す
+ */
+//*****************************************************************************************************************************
+inline uint8_t MPR121Detector::getAddress() {
+  return address;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 指定ポートの判定状態を取得する
+ * @param port 対象のポート番号
+ * @param state 取得先
+ * @return 使用ポートの場合true
+ */
+//*****************************************************************************************************************************
+inline bool MPR121Detector::getPortState(uint8_t port, MPR121PortState& state) {
+  if (port < maxPort && (activePort & (1 << port))) {
+    state.value = value[port];
+    state.lastValue = lastValue[port];
+    state.threshold = threshold[port];
+    state.reference = reference[port];
+    state.peakValue = peakValue[port];
+    state.peakSlope = peakSlope[port];
+    state.strength = strength[port];
+    state.counter = counter[port];
+    state.touched = (currentTouched >> port) & 1;
+    state.provisional = (provisionalTouched >> port) & 1;
+    return true;
+  } else return false;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief getPortState()で取得した判定状態を指定ポートに復元する
+ * @param port 対象のポート番号
+ * @param state 復元する状態
+ * @details 次の判定（update()／replay()／detect()）は取得時点の続きから判定を行う
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::setPortState(uint8_t port, const MPR121PortState& state) {
+  if (port < maxPort && (activePort & (1 << port))) {
+    value[port] = state.value;
+    lastValue[port] = state.lastValue;
+    threshold[port] = state.threshold;
+    reference[port] = state.reference;
+    peakValue[port] = state.peakValue;
+    peakSlope[port] = state.peakSlope;
+    strength[port] = state.strength;
+    counter[port] = state.counter;
+    currentTouched = (currentTouched & ~(1 << port)) | (state.touched << port);
+    provisionalTouched = (provisionalTouched & ~(1 << port)) | (state.provisional << port);
+    idlePort &= ~(1 << port);
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 行電極・列電極を指定してマトリクス（キーパッド）モードを設定する
+ * @param rowPort 行電極のポート番号の配列
+ * @param rows 行電極数
+ * @param colPort 列電極のポート番号の配列
+ * @param cols 列電極数
+ * @param keyMap 行・列に対応するキー番号（0～63）の配列（rows × cols要素、省略時は 行 × cols + 列）
+ * @return 設定できた場合true（使用ポート以外や重複したポートを指定した場合はfalse）
+ */
+//*****************************************************************************************************************************
+inline bool MPR121Detector::setMatrix(const uint8_t* rowPort, uint8_t rows, const uint8_t* colPort, uint8_t cols, const uint8_t* keyMap) {
+  if (rows == 0 || cols == 0 || rows + cols > maxPort) return false;
+
+  // 全ての電極が使用ポートであり、重複していないことを確認
+  uint16_t usedMask = 0;
+  for (uint8_t n = 0; n < rows + cols; ++n) {
+    uint8_t port = (n < rows) ? rowPort[n] : colPort[n - rows];
+    if (port >= maxPort || !((activePort >> port) & 1) || ((usedMask >> port) & 1)) return false;
+    usedMask |= (1 << port);
+  }
+  if (keyMap != nullptr) {
+    for (uint8_t n = 0; n < rows * cols; ++n) {
+      if (keyMap[n] >= 64) return false;
+    }
+  }
+
+  for (uint8_t r = 0; r < rows; ++r) matrixRow[r] = rowPort[r];
+  for (uint8_t c = 0; c < cols; ++c) matrixCol[c] = colPort[c];
+  for (uint8_t n = 0; n < rows * cols; ++n) {
+    matrixKey[n] = (keyMap != nullptr) ? keyMap[n] : n;
+  }
+  matrixRows = rows;
+  matrixCols = cols;
+  pressedKeys = 0;
+  return true;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief マトリクスモードを解除する
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::clearMatrix() {
+  matrixRows = 0;
+  matrixCols = 0;
+  pressedKeys = 0;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief マトリクスモードで指定キーが押下中かを返す
+ * @param key キー番号（0～63）
+ */
+//*****************************************************************************************************************************
+inline bool MPR121Detector::isKeyPressed(uint8_t key) {
+  if (key < 64) {
+    return (pressedKeys >> key) & 1;
+  } else return false;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief マトリクスモードで押下中のキーをビットで返す
+ * @return キー番号の位置のビットが1になった値
+ */
+//*****************************************************************************************************************************
+inline uint64_t MPR121Detector::getPressedKeys() {
+  return pressedKeys;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief タッチイベントの出力先を設定する
+ * @param sink 出力先（nullptrで出力しない）
+ * @details 出力は判定（update()／detect()）内で確定した時点で行われる
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::setEventSink(MPR121EventSink* sink) {
+  eventSink = sink;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 判定方式を設定する
+ * @param mode DETECT_FILTERED（平滑化値で判定）またはDETECT_BASELINE（ベースラインとの差分で判定）
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::setDetectMode(uint8_t mode) {
+  if (mode != DETECT_FILTERED && mode != DETECT_BASELINE) return;
+  detectMode = mode;
+
+  // 判定途中のカウントを破棄して閾値を再設定
+  for (uint8_t i = 0; i < maxPort; ++i) {
+    if ((activePort >> i) & 1) {
+      counter[i] = 0;
+      updateThreshold(i);
+    }
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 指定ポートのタッチ判定マージンを設定する
+ * @param port 対象のポート番号
+ * @param margin 設定するマージン値
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::setTouchMargin(uint8_t port, uint8_t margin) {
+  if (port < maxPort && (activePort & (1 << port))) {
+    touchMargin[port] = margin;
+
+    // 状態に応じて次のしきい値を固定
+    updateThreshold(port);
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 指定ポートのリリース判定マージンを設定する
+ * @param port 対象のポート番号
+ * @param margin 設定するマージン値
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::setReleaseMargin(uint8_t port, uint8_t margin) {
+  if (port < maxPort && (activePort & (1 << port))) {
+    releaseMargin[port] = margin;
+
+    // 状態に応じて次のしきい値を固定
+    updateThreshold(port);
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 指定ポートのセンサー下限値を設定する
+ * @param port 対象のポート番号
+ * @param value 設定する下限値（500以上の値を推奨）
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::setSensorMinValue(uint8_t port, uint16_t value) {
+  if (port < maxPort && (activePort & (1 << port))) {
+    minValue[port] = value;
+    idlePort &= ~(1 << port);
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 指定ポートのセンサー上限値を設定する
+ * @param port 対象のポート番号
+ * @param value 設定する上限値（720以下の値を推奨）
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::setSensorMaxValue(uint8_t port, uint16_t value) {
+  if (port < maxPort && (activePort & (1 << port))) {
+    maxValue[port] = value;
+    idlePort &= ~(1 << port);
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 指定ポートのタッチ判定に必要な連続回数を設定する
+ * @param port 対象のポート番号
+ * @param count 判定に必要な回数（10以上の値を推奨）
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::setTouchJugeCount(uint8_t port, uint8_t count) {
+  if (port < maxPort && (activePort & (1 << port))) {
+    touchJuge[port] = count;
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 指定ポートのリリース判定に必要な連続回数を設定する
+ * @param port 対象のポート番号
+ * @param count 判定に必要な回数（10以上の値を推奨）
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::setReleaseJugeCount(uint8_t port, uint8_t count) {
+  if (port < maxPort && (activePort & (1 << port))) {
+    releaseJuge[port] = count;
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 指定ポートの動的ヒステリシスの復帰率を設定する
+ * @param port 対象のポート番号
+ * @param ratio タッチの深さに対してリリース閾値を最小値から上げる割合[%]（0で無効、30～60を推奨）
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::setReleaseRatio(uint8_t port, uint8_t ratio) {
+  if (port < maxPort && (activePort & (1 << port))) {
+    releaseRatio[port] = (ratio > 100) ? 100 : ratio;
+
+    // タッチ中の場合は現在の最小値から閾値を再設定
+    if ((currentTouched >> port) & 1) {
+      updateThreshold(port);
+    }
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 指定ポートの先行タッチ検出の傾きを設定する
+ * @param port 対象のポート番号
+ * @param slope 仮タッチとする1回あたりのセンサー値の下降量（0で無効、touchMarginの1/3程度を推奨）
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::setPredictSlope(uint8_t port, uint8_t slope) {
+  if (port < maxPort && (activePort & (1 << port))) {
+    predictSlope[port] = slope;
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 指定ポートで判定前に行う処理段を設定する
+ * @param port 対象のポート番号
+ * @param stages PIPELINE_FILTER・PIPELINE_CLAMPの組み合わせ（PIPELINE_RAWで計測値をそのまま判定）
+ * @details 平滑化を外したポートは次回の判定から計測値をそのまま使う。閾値は変更しないため、
+ *          範囲制限を切り替えた場合など値の基準が変わる場合は、リリース中に設定すること。
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::setPipeline(uint8_t port, uint8_t stages) {
+  if (port < maxPort && (activePort & (1 << port))) {
+    pipeline[port] = stages & (PIPELINE_FILTER | PIPELINE_CLAMP);
+    idlePort &= ~(1 << port);
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief タッチ／リリースの判定を何回のupdate()／detect()に1回行うかを設定する
+ * @param factor 間引き率（1で毎回判定）
+ * @details 平滑化は毎回行うため、判定回数を減らしてもノイズ除去の効果は維持される
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::setDecimation(uint8_t factor) {
+  decimation = (factor < 1) ? 1 : factor;
+  decimationCount = 0;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 平滑化係数を設定する
+ * @param setAlpha 平滑化係数（0.01～1.0、1.0で平滑化なし）
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::setAlpha(float setAlpha) {
+  alpha = clampValue(setAlpha, 0.01, 1.0);
+  idlePort = 0;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 判定パラメータを設定データ（configSizeバイト）に書き出す
+ * @param buffer 書き出し先（configSizeバイト以上）
+ * @param size 書き出し先のサイズ
+ * @return 書き出したバイト数（サイズが足りない場合は0）
+ * @details 形式：'M' 'C' バージョン alpha×100、ポート0～11の {touchMargin releaseMargin touchJuge releaseJuge}、チェックサム
+ */
+//*****************************************************************************************************************************
+inline size_t MPR121Detector::saveConfig(uint8_t* buffer, size_t size) {
+  if (size < configSize) return 0;
+
+  uint8_t* p = buffer;
+  *p++ = 'M';
+  *p++ = 'C';
+  *p++ = configVersion;
+  *p++ = (uint8_t)(alpha * 100 + 0.5);
+  for (uint8_t i = 0; i < maxPort; ++i) {
+    bool used = (activePort >> i) & 1;
+    *p++ = used ? (uint8_t)clampValue(touchMargin[i], 0, 255) : 0;
+    *p++ = used ? (uint8_t)clampValue(releaseMargin[i], 0, 255) : 0;
+    *p++ = used ? touchJuge[i] : 0;
+    *p++ = used ? releaseJuge[i] : 0;
+  }
+
+  // 末尾は先頭からの合計（下位8bit）
+  uint8_t sum = 0;
+  for (uint8_t* q = buffer; q < p; ++q) sum += *q;
+  *p++ = sum;
+  return p - buffer;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief saveConfig()またはホストのパラメータ探索ツールで作成した設定データを読み込む
+ * @param buffer 設定データ
+ * @param size 設定データのサイズ
+ * @return 形式・チェックサムが正しく、設定を反映した場合true
+ * @details 使用していないポートの値は無視する
+ */
+//*****************************************************************************************************************************
+inline bool MPR121Detector::loadConfig(const uint8_t* buffer, size_t size) {
+  if (size < configSize) return false;
+  if (buffer[0] != 'M' || buffer[1] != 'C' || buffer[2] != configVersion) return false;
+
+  uint8_t sum = 0;
+  for (size_t n = 0; n < configSize - 1; ++n) sum += buffer[n];
+  if (sum != buffer[configSize - 1]) return false;
+
+  setAlpha(buffer[3] / 100.0);
+  const uint8_t* p = &buffer[4];
+  for (uint8_t i = 0; i < maxPort; ++i, p += 4) {
+    setTouchMargin(i, p[0]);
+    setReleaseMargin(i, p[1]);
+    setTouchJugeCount(i, p[2]);
+    setReleaseJugeCount(i, p[3]);
+  }
+  return true;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 判定状態（センサー値・閾値・カウンタ・タッチ状態）を状態データに書き出す
+ * @param buffer 書き出し先（stateMaxSizeバイトあれば全ポート分が収まる）
+ * @param size 書き出し先のサイズ
+ * @return 書き出したバイト数（サイズが足りない場合は0）
+ * @details 形式：'M' 'S' バージョン 使用ポート(2) タッチ状態(2) 仮タッチ状態(2) 間引きカウンタ 判定方式 押下キー(8)、
+ *          使用ポートごとに {value lastValue threshold reference peakValue peakSlope（各float） strength(2) counter}、チェックサム
+ *          floatはメモリ上の表現のまま格納するため、同じ種類のマイコン間でのみ互換がある
+ */
+//*****************************************************************************************************************************
+inline size_t MPR121Detector::saveState(uint8_t* buffer, size_t size) {
+  uint8_t ports = 0;
+  for (uint8_t i = 0; i < maxPort; ++i) ports += (activePort >> i) & 1;
+  if (size < (size_t)(stateHeaderSize + ports * statePortSize + 1)) return 0;
+
+  uint8_t* p = buffer;
+  *p++ = 'M';
+  *p++ = 'S';
+  *p++ = stateVersion;
+  *p++ = activePort & 0xFF;
+  *p++ = activePort >> 8;
+  *p++ = currentTouched & 0xFF;
+  *p++ = currentTouched >> 8;
+  *p++ = provisionalTouched & 0xFF;
+  *p++ = provisionalTouched >> 8;
+  *p++ = decimationCount;
+  *p++ = detectMode;
+  for (uint8_t n = 0; n < 8; ++n) *p++ = (pressedKeys >> (n * 8)) & 0xFF;
+
+  for (uint8_t i = 0; i < maxPort; ++i) {
+    if ((activePort >> i) & 1) {
+      const float values[6] = { value[i], lastValue[i], threshold[i], reference[i], peakValue[i], peakSlope[i] };
+      memcpy(p, values, sizeof(values));
+      p += sizeof(values);
+      *p++ = strength[i] & 0xFF;
+      *p++ = (uint16_t)strength[i] >> 8;
+      *p++ = counter[i];
+    }
+  }
+
+  // 末尾は先頭からの合計（下位8bit）
+  uint8_t sum = 0;
+  for (uint8_t* q = buffer; q < p; ++q) sum += *q;
+  *p++ = sum;
+  return p - buffer;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief saveState()で書き出した状態データから判定状態を復元する
+ * @param buffer 状態データ
+ * @param size 状態データのサイズ
+ * @return 形式・チェックサム・使用ポート・判定方式が一致し、復元した場合true
+ * @details ウォッチドッグリセットやディープスリープからの復帰時に、閾値を取り直さずに判定を再開できる
+ */
+//*****************************************************************************************************************************
+inline bool MPR121Detector::loadState(const uint8_t* buffer, size_t size) {
+  if (size < stateHeaderSize + 1) return false;
+  if (buffer[0] != 'M' || buffer[1] != 'S' || buffer[2] != stateVersion) return false;
+  if ((buffer[3] | (buffer[4] << 8)) != activePort || buffer[10] != detectMode) return false;
+
+  uint8_t ports = 0;
+  for (uint8_t i = 0; i < maxPort; ++i) ports += (activePort >> i) & 1;
+  size_t length = stateHeaderSize + ports * statePortSize;
+  if (size < length + 1) return false;
+
+  uint8_t sum = 0;
+  for (size_t n = 0; n < length; ++n) sum += buffer[n];
+  if (sum != buffer[length]) return false;
+
+  currentTouched = buffer[5] | (buffer[6] << 8);
+  provisionalTouched = buffer[7] | (buffer[8] << 8);
+  decimationCount = buffer[9];
+  idlePort = 0;
+  pressedKeys = 0;
+  for (uint8_t n = 0; n < 8; ++n) pressedKeys |= (uint64_t)buffer[11 + n] << (n * 8);
+
+  const uint8_t* p = &buffer[stateHeaderSize];
+  for (uint8_t i = 0; i < maxPort; ++i) {
+    if ((activePort >> i) & 1) {
+      float values[6];
+      memcpy(values, p, sizeof(values));
+      p += sizeof(values);
+      value[i] = values[0];
+      lastValue[i] = values[1];
+      threshold[i] = values[2];
+      reference[i] = values[3];
+      peakValue[i] = values[4];
+      peakSlope[i] = values[5];
+      strength[i] = (int16_t)(p[0] | (p[1] << 8));
+      counter[i] = p[2];
+      p += 3;
+    }
+  }
+  return true;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 取得済みの計測値（rawData）を平滑化してタッチ／リリースを判定する
+ * @param now 判定時刻[us]（発生したイベントの時刻とする）
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::processSensorData(uint32_t now) {
+  eventTime = now;
+
+  // 判定は間引き率に応じて一定回数ごとに行う
+  bool decide = false;
+  if (++decimationCount >= decimation) {
+    decimationCount = 0;
+    decide = true;
+  }
+
+  // ベースライン基準では範囲制限は不要
+  uint8_t usable = (detectMode == DETECT_BASELINE) ? PIPELINE_FILTER : (PIPELINE_FILTER | PIPELINE_CLAMP);
+
+  for (uint8_t i = 0; i < maxPort; ++i) {
+    if ((activePort >> i) & 1) {
+      // 範囲外のポートは判定しない
+      if ((faultPort >> i) & 1) {
+        strength[i] = 0;
+        continue;
+      }
+
+      // 安定しているポートは、計測値（ベースライン基準ではベースラインも）が変わらない限り処理を省略
+      uint16_t raw = rawData[i];
+      if (((idlePort >> i) & 1) && raw == idleRaw[i]
+          && (detectMode != DETECT_BASELINE || baseline[i] == idleBaseline[i])) {
+        continue;
+      }
+      idlePort &= ~(1 << i);
+      float before = value[i];
+
+      // センサーの生値をポートごとに有効な処理段のみ通す
+      switch (pipeline[i] & usable) {
+        case PIPELINE_FILTER | PIPELINE_CLAMP:
+          value[i] = alpha * raw + (1.0 - alpha) * value[i];
+          value[i] = clampValue(value[i], minValue[i], maxValue[i]);
+          break;
+        case PIPELINE_FILTER:
+          value[i] = alpha * raw + (1.0 - alpha) * value[i];
+          break;
+        case PIPELINE_CLAMP:
+          value[i] = clampValue(raw, minValue[i], maxValue[i]);
+          break;
+        default:
+          value[i] = raw;
+          break;
+      }
+
+      // 間引き中は平滑化のみ
+      if (!decide) continue;
+
+      // 前回判定時からの変化量（傾き）の計算用
+      float previous = lastValue[i];
+      lastValue[i] = value[i];
+
+      // 現在のタッチ状態（ビットで取得）
+      bool touched = (currentTouched >> i) & 1;
+
+      // タッチ中の最小値を記録
+      bool deeper = touched && value[i] < peakValue[i];
+      if (deeper) peakValue[i] = value[i];
+
+      // ベースライン基準は毎回、動的ヒステリシスは最小値の更新時に閾値を追従させる
+      if (detectMode == DETECT_BASELINE || (deeper && releaseRatio[i] > 0)) {
+        updateThreshold(i);
+      }
+
+      // 基準値からの下がり幅をタッチマージンで正規化してタッチ強度とする
+      if (touchMargin[i] > 0) {
+        float depth = (reference[i] - value[i]) * 256.0 / touchMargin[i];
+        strength[i] = (int16_t)clampValue(depth, -32768.0, 32767.0);
+      }
+
+      // 判定条件（状態に応じて比較方向を変える）
+      bool conditionMet = touched
+                            ? (value[i] > threshold[i])   // タッチ中：値がしきい値より上 → リリース
+                            : (value[i] < threshold[i]);  // リリース中：値がしきい値より下 → タッチ
+
+      // 判定結果に応じてカウンター処理
+      if (conditionMet) {
+        counter[i]++;
+
+        // 判定方向への1回あたりの変化量の最大値を記録（ベロシティ用）
+        float slope = touched ? (value[i] - previous) : (previous - value[i]);
+        if (counter[i] == 1 || slope > peakSlope[i]) peakSlope[i] = slope;
+      } else {
+        counter[i] = 0;
+      }
+
+      // リリース中は傾きから仮タッチを判定
+      if (!touched && predictSlope[i] > 0) predictTouch(i, previous - value[i]);
+
+      // カウンターが規定値に達したら状態を反転
+      if ((!touched && counter[i] > touchJuge[i]) || (touched && counter[i] > releaseJuge[i])) {
+
+        currentTouched ^= (1 << i);       // 状態を反転
+        provisionalTouched &= ~(1 << i);  // 仮タッチは確定または終了
+        counter[i] = 0;
+        peakValue[i] = value[i];
+
+        // 状態に応じて次のしきい値を固定
+        updateThreshold(i);
+
+        // 出力先があればその場でイベントを出力
+        if (hasEventOutput()) {
+          emitEvent(i, touched ? MPR121Event::RELEASE : MPR121Event::TOUCH, peakSlope[i]);
+        }
+      }
+
+      // 値・傾きが変わらず判定条件も満たさない（カウンタが0のまま）場合、同じ計測値が続く間は結果が変わらない
+      if (value[i] == before && value[i] == previous && !conditionMet && !((provisionalTouched >> i) & 1)) {
+        idlePort |= (1 << i);
+        idleRaw[i] = raw;
+        idleBaseline[i] = baseline[i];
+      }
+    }
+  }
+
+  // マトリクスモードでは行・列の判定結果からキーを求める
+  if (decide && matrixRows > 0) decodeMatrix();
+
+  // 判定が完了してから、発生したイベントを待っているコルーチンを再開
+  dispatchEvents();
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief センサー値の傾きから仮タッチの開始／取り消しを判定する
+ * @param port 対象のポート番号
+ * @param slope 今回のセンサー値の下降量
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::predictTouch(uint8_t port, float slope) {
+  if (!((provisionalTouched >> port) & 1)) {
+    // 下降が速く、次回には閾値を下回る見込みであれば仮タッチ
+    if (slope >= predictSlope[port] && value[port] - slope < threshold[port]) {
+      provisionalTouched |= (1 << port);
+      if (hasEventOutput()) emitEvent(port, MPR121Event::TOUCH_BEGIN, slope);
+    }
+  } else if (counter[port] == 0 && slope <= 0) {
+    // 閾値を下回らないまま下降が止まった場合は取り消し
+    provisionalTouched &= ~(1 << port);
+    if (hasEventOutput()) emitEvent(port, MPR121Event::TOUCH_CANCEL, 0);
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief タッチイベントを作成して出力先に渡す
+ * @param port 対象のポート番号
+ * @param type イベント種別
+ * @param slope 判定中に観測した1回あたりの最大変化量
+ * @details 変化量がタッチマージンと同じ場合にベロシティ127となるように換算する
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::emitEvent(uint8_t port, uint8_t type, float slope) {
+  float velocity = (touchMargin[port] > 0) ? slope * 127.0 / touchMargin[port] : 127.0;
+
+  MPR121Event event;
+  event.address = address;
+  event.port = port;
+  event.type = type;
+  event.velocity = (uint8_t)clampValue(velocity, 1.0, 127.0);
+  event.time = eventTime;
+  if (eventSink != nullptr) eventSink->onEvent(event);
+
+#ifdef MPR121_COROUTINE
+  // 待機中のコルーチンには判定の完了後に渡す（キューが一杯の場合は新しいイベントを捨てる）
+  if (awaiters != nullptr && eventCount < eventQueueSize) {
+    eventQueue[(eventHead + eventCount) % eventQueueSize] = event;
+    eventCount++;
+  }
+#endif
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief タッチイベントの出力先があるか判定する
+ * @return 出力先が設定されているか、イベントを待っているコルーチンがある場合true
+ */
+//*****************************************************************************************************************************
+inline bool MPR121Detector::hasEventOutput() {
+#ifdef MPR121_COROUTINE
+  if (awaiters != nullptr) return true;
+#endif
+  return eventSink != nullptr;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief キューに積んだイベントを待機中のコルーチンに渡して再開する（コルーチン非対応の場合は何もしない）
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::dispatchEvents() {
+#ifdef MPR121_COROUTINE
+  if (eventCount > 0) resumeAwaiters();
+#endif
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 行電極・列電極のタッチ状態と強度から押下中のキーを判定する
+ * @details 行または列の一方が1本だけの場合は曖昧さがないため全ての組み合わせを押下とし、
+ *          行・列ともに複数本タッチされている場合は強度の合計が最大の組み合わせのみを押下とする
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::decodeMatrix() {
+  uint8_t rowCount = 0, colCount = 0;
+  uint8_t bestRow = 0, bestCol = 0;
+  int16_t bestRowStrength = -32768, bestColStrength = -32768;
+
+  // タッチ中の行・列を数え、それぞれ最も強いものを記録
+  for (uint8_t r = 0; r < matrixRows; ++r) {
+    uint8_t port = matrixRow[r];
+    if ((currentTouched >> port) & 1) {
+      rowCount++;
+      if (strength[port] > bestRowStrength) {
+        bestRow = r;
+        bestRowStrength = strength[port];
+      }
+    }
+  }
+  for (uint8_t c = 0; c < matrixCols; ++c) {
+    uint8_t port = matrixCol[c];
+    if ((currentTouched >> port) & 1) {
+      colCount++;
+      if (strength[port] > bestColStrength) {
+        bestCol = c;
+        bestColStrength = strength[port];
+      }
+    }
+  }
+
+  pressedKeys = 0;
+  if (rowCount == 0 || colCount == 0) return;
+
+  // 行・列ともに複数の場合は最も強い組み合わせのみ
+  if (rowCount > 1 && colCount > 1) {
+    pressedKeys = (uint64_t)1 << matrixKey[bestRow * matrixCols + bestCol];
+    return;
+  }
+
+  for (uint8_t r = 0; r < matrixRows; ++r) {
+    if (!((currentTouched >> matrixRow[r]) & 1)) continue;
+    for (uint8_t c = 0; c < matrixCols; ++c) {
+      if ((currentTouched >> matrixCol[c]) & 1) {
+        pressedKeys |= (uint64_t)1 << matrixKey[r * matrixCols + c];
+      }
+    }
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 現在のタッチ状態に応じて指定ポートの閾値を設定する
+ * @param port 対象のポート番号
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::updateThreshold(uint8_t port) {
+  bool touched = (currentTouched >> port) & 1;
+
+  // 閾値が変わるため処理の省略を解除
+  idlePort &= ~(1 << port);
+
+  // ベースライン基準では基準値をベースラインに追従させる
+  if (detectMode == DETECT_BASELINE) reference[port] = baseline[port];
+
+  if (touched && releaseRatio[port] > 0) {
+    // 動的ヒステリシス：タッチ中の最小値から深さの一定割合だけ上げて設定
+    float margin = (reference[port] - peakValue[port]) * releaseRatio[port] / 100.0;
+    if (margin < releaseMargin[port]) margin = releaseMargin[port];
+    threshold[port] = peakValue[port] + margin;
+  } else if (detectMode == DETECT_BASELINE) {
+    // ベースライン基準：ベースラインからマージン分下げた値を閾値とする
+    threshold[port] = reference[port] - (touched ? releaseMargin[port] : touchMargin[port]);
+  } else if (touched) {
+    // タッチ中：リリース判定の基準値を上げて設定
+    threshold[port] = value[port] + releaseMargin[port];
+  } else {
+    // リリース中：現在値を基準値とし、タッチ状態に戻るための基準値を下げて設定
+    reference[port] = value[port];
+    threshold[port] = value[port] - touchMargin[port];
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 全ポートの判定状態を初期化し、現在の計測値から閾値を取り直す
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::restartDetection() {
+  releaseAll();
+  for (uint8_t i = 0; i < maxPort; ++i) {
+    if ((activePort >> i) & 1) restartPort(i);
+  }
+  dispatchEvents();
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 指定ポートの判定状態を初期化し、現在の計測値から閾値を取り直す
+ * @param port 対象のポート番号
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::restartPort(uint8_t port) {
+  value[port] = rawData[port];
+  if (detectMode != DETECT_BASELINE && (pipeline[port] & PIPELINE_CLAMP)) {
+    value[port] = clampValue(value[port], minValue[port], maxValue[port]);
+  }
+  lastValue[port] = value[port];
+  counter[port] = 0;
+  strength[port] = 0;
+  releasePort(port);
+  updateThreshold(port);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 指定ポートのタッチ・仮タッチを解除する
+ * @param port 対象のポート番号
+ * @details 判定によらず解除するため、出力先にはタッチ中ならリリース、仮タッチ中なら取り消しのイベントを出力する。
+ *          待機中のコルーチンへはdispatchEvents()で渡す
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::releasePort(uint8_t port) {
+  uint16_t bit = 1 << port;
+  if (hasEventOutput()) {
+    if (currentTouched & bit) emitEvent(port, MPR121Event::RELEASE, 0);
+    else if (provisionalTouched & bit) emitEvent(port, MPR121Event::TOUCH_CANCEL, 0);
+  }
+  currentTouched &= ~bit;
+  provisionalTouched &= ~bit;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 全ポートのタッチ・仮タッチと押下中のキーを解除する（イベントの出力はreleasePort()と同じ）
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::releaseAll() {
+  for (uint8_t i = 0; i < maxPort; ++i) {
+    if ((activePort >> i) & 1) releasePort(i);
+  }
+  currentTouched = 0;
+  provisionalTouched = 0;
+  pressedKeys = 0;
+}
+
+#ifdef MPR121_COROUTINE
+//*****************************************************************************************************************************
+/**
+ * @brief 次のタッチイベントを待つ
+ * @param port 待機するポート番号（MPR121EventAwaiter::anyPortで全ポート）
+ * @return co_awaitする待機（再開時に発生したイベントを返す）
+ * @details 待機はco_awaitした時点で登録され、判定（update()／detect()）で該当するイベントが発生するとその最後に再開される
+ */
+//*****************************************************************************************************************************
+inline MPR121EventAwaiter MPR121Detector::nextEvent(uint8_t port) {
+  return MPR121EventAwaiter(*this, port);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief デストラクタ（待機中・再開待ちのコルーチンの待機を全て取り消す）
+ * @details 取り消したコルーチンは再開されずに中断したまま残るが、後でフレームが破棄されても破棄済みの判定処理には触れない
+ */
+//*****************************************************************************************************************************
+inline MPR121Detector::~MPR121Detector() {
+  MPR121EventAwaiter** lists[2] = { &awaiters, &resuming };
+  for (MPR121EventAwaiter** list : lists) {
+    while (*list != nullptr) {
+      MPR121EventAwaiter* awaiter = *list;
+      *list = awaiter->next;
+      awaiter->next = nullptr;
+      awaiter->waiting = false;
+    }
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 待機を待機開始順の末尾に登録する
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::addAwaiter(MPR121EventAwaiter* awaiter) {
+  awaiter->next = nullptr;
+  awaiter->waiting = true;
+  MPR121EventAwaiter** link = &awaiters;
+  while (*link != nullptr) link = &(*link)->next;
+  *link = awaiter;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 待機を取り消す（待機中・再開待ちのどちらからも外す）
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::removeAwaiter(MPR121EventAwaiter* awaiter) {
+  MPR121EventAwaiter** lists[2] = { &awaiters, &resuming };
+  for (MPR121EventAwaiter** list : lists) {
+    for (MPR121EventAwaiter** link = list; *link != nullptr; link = &(*link)->next) {
+      if (*link == awaiter) {
+        *link = awaiter->next;
+        awaiter->waiting = false;
+        return;
+      }
+    }
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief キューのイベントを発生順に取り出し、そのポートを待っているコルーチンを再開する
+ * @details 該当する待機を先に再開待ちへ移してから1件ずつ再開するため、再開したコルーチンが再び待機しても
+ *          同じイベントを受け取ることはなく、後続のイベントは受け取れる
+ */
+//*****************************************************************************************************************************
+inline void MPR121Detector::resumeAwaiters() {
+  while (eventCount > 0) {
+    MPR121Event event = eventQueue[eventHead];
+    eventHead = (eventHead + 1) % eventQueueSize;
+    eventCount--;
+
+    // 該当する待機を順序を保ったまま再開待ちへ移す
+    MPR121EventAwaiter** tail = &resuming;
+    for (MPR121EventAwaiter** link = &awaiters; *link != nullptr;) {
+      MPR121EventAwaiter* awaiter = *link;
+      if (awaiter->port == MPR121EventAwaiter::anyPort || awaiter->port == event.port) {
+        *link = awaiter->next;
+        awaiter->next = nullptr;
+        *tail = awaiter;
+        tail = &awaiter->next;
+      } else {
+        link = &awaiter->next;
+      }
+    }
+
+    // 1件ずつ外してから再開（再開中に他の待機が破棄された場合も一覧から外れている）
+    while (resuming != nullptr) {
+      MPR121EventAwaiter* awaiter = resuming;
+      resuming = awaiter->next;
+      awaiter->waiting = false;
+      awaiter->event = event;
+      awaiter->handle.resume();
+    }
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 待機を登録してコルーチンを中断する
+ */
+//*****************************************************************************************************************************
+inline void MPR121EventAwaiter::await_suspend(std::coroutine_handle<> setHandle) noexcept {
+  handle = setHandle;
+  detector.addAwaiter(this);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief デストラクタ（中断中のコルーチンが破棄された場合は待機を取り消す）
+ */
+//*****************************************************************************************************************************
+inline MPR121EventAwaiter::~MPR121EventAwaiter() {
+  if (waiting) detector.removeAwaiter(this);
+}
+#endif
+
+#endif
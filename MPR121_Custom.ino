@@ -8,6 +8,7 @@ vector<String> labels = { "Left", "Center", "Right" };  // ポートラベル配
 
 // インスタンスの作成
 MPR121Manager mpr121(0x5A, usedPortMask);
+// MPR121MidiOut midiOut(Serial1);  // MIDI出力（使用する場合）
 
 //*****************************************************************************************************************************
 // セットアップ
@@ -21,6 +22,12 @@ void setup() {
   // mpr121.setTouchMargin(0, 50);  // タッチマージンを設定
   // mpr121.setSensorMinValue(0, 300);  // センサー値の下限値を設定
   // mpr121.setTouchJugeCount(0, 40);   // タッチ判定回数の設定
+  // mpr121.setDetectMode(MPR121Manager::DETECT_BASELINE);  // ベースライン差分で判定
+  // mpr121.setAutoConfigLimit(3.3);  // 電源電圧に合わせて自動キャリブレーションの充電目標を設定
+  // mpr121.loadConfig(mpr121Config, sizeof(mpr121Config));  // host/tune_paramsが出力した設定データを読み込む
+  // mpr121.loadState(savedState, sizeof(savedState));  // saveState()で保持しておいた判定状態から再開（リセット・スリープ復帰時）
+  // Serial1.begin(31250);  // MIDI出力を開始
+  // mpr121.setEventSink(&midiOut);  // タッチ／リリースをMIDIで出力
   Serial.println("\n------ Setup End ------\n");
 }
 
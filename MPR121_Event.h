@@ -0,0 +1,40 @@
+/**
+ * @file MPR121_Event
+ * @brief 静電センサーのタッチイベント
+ * @details 判定処理（MPR121Detector）が出力するイベントと、その出力先の基底クラス。
+ *          Arduinoの型に依存しないため、マイコンとホストの両方で使用できる。
+ */
+
+// インクルードガード
+#ifndef MPR121_EVENT_H
+#define MPR121_EVENT_H
+
+#include <stdint.h>
+
+//*****************************************************************************************************************************
+// タッチイベント
+struct MPR121Event {
+  // イベント種別
+  enum Type : uint8_t {
+    TOUCH = 0,     // タッチ確定
+    RELEASE,       // リリース確定
+    TOUCH_BEGIN,   // 仮タッチ（傾きによる先行検出）
+    TOUCH_CANCEL,  // 仮タッチの取り消し
+  };
+
+  uint8_t address;   // 基板のI2Cアドレス
+  uint8_t port;      // ポート番号
+  uint8_t type;      // イベント種別
+  uint8_t velocity;  // ベロシティ（1～127）
+  uint32_t time;     // 発生時刻[us]
+};
+
+//*****************************************************************************************************************************
+// タッチイベントの出力先（基底クラス）
+class MPR121EventSink {
+public:
+  virtual ~MPR121EventSink() {}
+  virtual void onEvent(const MPR121Event& event) = 0;  // イベント発生時に呼ばれる
+};
+
+#endif
@@ -0,0 +1,223 @@
+
+#include "MPR121_Log.h"
+
+//*****************************************************************************************************************************
+/**
+ * @brief コンストラクタ
+ * @param setOutput 記録の出力先（書き込み用に開いたSDのFileなど）
+ */
+//*****************************************************************************************************************************
+MPR121Logger::MPR121Logger(Print& setOutput)
+  : output(setOutput) {}
+
+//*****************************************************************************************************************************
+/**
+ * @brief ファイルヘッダーを書き込んで記録を開始する
+ * @param setPortMask 記録するポートのビットマスク（MPR121Manager::getPortMask()）
+ */
+//*****************************************************************************************************************************
+void MPR121Logger::begin(uint16_t setPortMask) {
+  portMask = setPortMask & 0x0FFF;
+  ports = 0;
+  for (uint8_t i = 0; i < maxPort; ++i) ports += (portMask >> i) & 1;
+
+  written = 0;
+  blocks = 0;
+  count = 0;
+  indexCount = 0;
+  indexStride = 1;
+
+  const char* magic = "M121LOG";
+  for (uint8_t n = 0; n < 7; ++n) put(magic[n], true);
+  put(version, true);
+  put(portMask & 0xFF, true);
+  put(portMask >> 8, true);
+  put(ports, true);
+  put(blockScans, true);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 1スキャン分の計測値とタッチ状態を記録する
+ * @param time 計測時刻[us]
+ * @param values 使用ポートの計測値（ポート番号順に詰めたもの）
+ * @param touched タッチ中のポートのビットマスク
+ * @details blockScans回分たまった時点でブロックを書き込む
+ */
+//*****************************************************************************************************************************
+void MPR121Logger::log(uint64_t time, const uint16_t* values, uint16_t touched) {
+  if (count == 0) {
+    blockTime = time;
+    delta[0] = 0;
+  } else {
+    delta[count] = (uint32_t)(time - lastTime);
+  }
+  lastTime = time;
+  touchMask[count] = touched & portMask;
+  for (uint8_t n = 0; n < ports; ++n) value[count][n] = values[n];
+
+  if (++count >= blockScans) flush();
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 直近のupdate()で取得した計測値と判定結果を、現在時刻で記録する
+ * @param manager 記録する静電センサー
+ */
+//*****************************************************************************************************************************
+void MPR121Logger::log(MPR121Manager& manager) {
+  // micros()の桁あふれを補正して64bitの時刻にする
+  uint32_t now = micros();
+  if (now < lastMicros) microsHigh += 0x100000000ULL;
+  lastMicros = now;
+
+  uint16_t values[maxPort];
+  manager.getRawSnapshot(values);
+  log(microsHigh + now, values, manager.getTouchedPorts());
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief バッファ中のスキャンを1ブロックとして書き込む
+ */
+//*****************************************************************************************************************************
+void MPR121Logger::flush() {
+  if (count == 0) return;
+  addIndex();
+
+  // データ長を先に求めてからヘッダーとデータを書き込む
+  uint16_t length = encodeBlock(false);
+  put('B', true);
+  put(count, true);
+  put(length & 0xFF, true);
+  put(length >> 8, true);
+  for (uint8_t n = 0; n < 8; ++n) put((blockTime >> (n * 8)) & 0xFF, true);
+  encodeBlock(true);
+
+  blocks++;
+  count = 0;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 途中のブロックと索引を書き込んで記録を終了する
+ */
+//*****************************************************************************************************************************
+void MPR121Logger::finish() {
+  flush();
+
+  uint32_t indexOffset = written;
+  put('I', true);
+  put(indexCount, true);
+  put(indexStride & 0xFF, true);
+  put(indexStride >> 8, true);
+  for (uint8_t i = 0; i < indexCount; ++i) {
+    for (uint8_t n = 0; n < 8; ++n) put((index[i].time >> (n * 8)) & 0xFF, true);
+    for (uint8_t n = 0; n < 4; ++n) put((index[i].offset >> (n * 8)) & 0xFF, true);
+  }
+  for (uint8_t n = 0; n < 4; ++n) put((indexOffset >> (n * 8)) & 0xFF, true);
+  const char* magic = "MIDX";
+  for (uint8_t n = 0; n < 4; ++n) put(magic[n], true);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 書き込んだバイト数を返す
+ */
+//*****************************************************************************************************************************
+uint32_t MPR121Logger::getBytesWritten() {
+  return written;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 1バイト出力する
+ * @param data 出力するデータ
+ * @param write falseの場合は出力せずにencodeBlock()のデータ長の計算のみ行う
+ */
+//*****************************************************************************************************************************
+void MPR121Logger::put(uint8_t data, bool write) {
+  if (write) {
+    output.write(data);
+    written++;
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 可変長整数（下位から7bitずつ、最上位bitが継続フラグ）を出力する
+ */
+//*****************************************************************************************************************************
+void MPR121Logger::putVarint(uint32_t data, bool write) {
+  while (data >= 0x80) {
+    put((data & 0x7F) | 0x80, write);
+    data >>= 7;
+  }
+  put(data, write);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief バッファ中のスキャンを列ごとに差分符号化して出力する
+ * @param write falseの場合は出力せずにデータ長のみ求める
+ * @return データ長[バイト]
+ */
+//*****************************************************************************************************************************
+uint16_t MPR121Logger::encodeBlock(bool write) {
+  uint32_t start = written;
+  uint16_t length = 0;
+
+  // 出力しない場合は可変長整数の長さを数える
+  auto emit = [&](uint32_t data) {
+    if (write) {
+      putVarint(data, true);
+    } else {
+      do {
+        length++;
+        data >>= 7;
+      } while (data > 0);
+    }
+  };
+
+  // 時刻列（先頭はヘッダーに記録済み）
+  for (uint8_t s = 1; s < count; ++s) emit(delta[s]);
+
+  // タッチ列
+  uint16_t previousMask = 0;
+  for (uint8_t s = 0; s < count; ++s) {
+    emit(touchMask[s] ^ previousMask);
+    previousMask = touchMask[s];
+  }
+
+  // 計測値列（ジグザグ符号化で小さな負の差分も1バイトに収める）
+  for (uint8_t n = 0; n < ports; ++n) {
+    int32_t previous = 0;
+    for (uint8_t s = 0; s < count; ++s) {
+      int32_t diff = (int32_t)value[s][n] - previous;
+      emit(((uint32_t)diff << 1) ^ (uint32_t)(diff >> 31));
+      previous = value[s][n];
+    }
+  }
+  return write ? (uint16_t)(written - start) : length;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 書き込むブロックが索引の間隔に当たる場合は登録する
+ * @details 索引が一杯になった場合は1件おきに間引いて間隔を倍にする
+ */
+//*****************************************************************************************************************************
+void MPR121Logger::addIndex() {
+  if (blocks % indexStride != 0) return;
+
+  if (indexCount >= maxIndex) {
+    // 偶数番目を残す（件数が奇数の場合は末尾も残す）
+    for (uint8_t i = 0; i < (maxIndex + 1) / 2; ++i) index[i] = index[i * 2];
+    indexCount = (maxIndex + 1) / 2;
+    indexStride *= 2;
+    if (blocks % indexStride != 0) return;
+  }
+  index[indexCount].time = blockTime;
+  index[indexCount].offset = written;
+  indexCount++;
+}
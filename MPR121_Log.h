@@ -0,0 +1,111 @@
+/**
+ * @file MPR121_Log
+ * @brief 静電センサーの計測値記録（列指向・差分＋可変長符号化）
+ * @details スキャンごとの計測値とタッチ状態をblockScans回分まとめ、列ごとに差分を可変長整数で書き出す。
+ *          printStatus()のテキストと比べて10分の1以下の容量で記録でき、ブロック単位で任意の時刻から読み出せる。
+ *          ホスト側の読み出しは host/LogReader.h を使用する。
+ *
+ * @section 使い方
+ *    File file = SD.open("touch.log", FILE_WRITE);
+ *    MPR121Logger logger(file);
+ *    logger.begin(mpr121.getPortMask());
+ *    // loop()内
+ *    mpr121.update();
+ *    logger.log(mpr121);
+ *    // 記録終了時（索引を書き込む。書き込まずに電源が切れた場合もホスト側で読み出せる）
+ *    logger.finish();
+ *
+ * @section 形式（数値はリトルエンディアン）
+ * - ファイルヘッダー（12バイト）："M121LOG" バージョン 使用ポート(2) ポート数 ブロックのスキャン数
+ * - ブロック：'B' スキャン数 データ長(2) 先頭時刻[us](8)、続いてデータ
+ *    時刻列    ：2スキャン目以降の前スキャンからの経過時間（可変長整数）
+ *    タッチ列  ：前スキャンとのタッチ状態の排他的論理和（可変長整数、ブロック先頭は0との比較）
+ *    計測値列  ：使用ポートごとに前スキャンとの差分（ジグザグ符号化した可変長整数、ブロック先頭は0との差分）
+ *    ブロック内で完結しているため、どのブロックからでも単独で復元できる。
+ * - 索引（finish()で書き込み）：'I' 件数 間隔(2) {先頭時刻(8) ファイル位置(4)}×件数 索引の位置(4) "MIDX"
+ *    RAMを固定量に抑えるため、件数がmaxIndexに達するたびに間引いて間隔を倍にする（間隔ごとのブロックを指す疎な索引）。
+ *
+ * @section メモ
+ * - 1インスタンスあたり、ブロック1個分のバッファ（blockScans × (12ポート × 2 + 6) バイト）と索引（maxIndex × 12バイト）を保持する。
+ *    初期値（32スキャン・32件）では約1.4KBとなるため、RAMの少ないマイコン（AVRなど）では
+ *    ビルドオプションでMPR121_LOG_BLOCK_SCANS（1～255）とMPR121_LOG_MAX_INDEX（2～255）を小さくすること
+ *    （例：-DMPR121_LOG_BLOCK_SCANS=8 -DMPR121_LOG_MAX_INDEX=8で約0.4KB）。
+ *    MPR121_Log.cppも同じ値でコンパイルされるよう、スケッチ内の#defineではなくビルドオプション（platformio.iniのbuild_flagsなど）で指定する。
+ *    ブロックのスキャン数は各ブロックヘッダーに記録されるため、ホスト側はどの値で記録したファイルも読み出せる
+ * - 時刻はmicros()の桁あふれを補正して64bitで記録する
+ */
+
+// インクルードガード
+#ifndef MPR121_LOG_H
+#define MPR121_LOG_H
+
+#include <Arduino.h>          // Arduinoライブラリ
+#include "MPR121_Config.h"    // 静電センサー管理
+
+// 1ブロックのスキャン数（ビルドオプションで変更可能）
+#ifndef MPR121_LOG_BLOCK_SCANS
+#define MPR121_LOG_BLOCK_SCANS 32
+#endif
+
+// 索引の最大件数（ビルドオプションで変更可能）
+#ifndef MPR121_LOG_MAX_INDEX
+#define MPR121_LOG_MAX_INDEX 32
+#endif
+
+static_assert(MPR121_LOG_BLOCK_SCANS >= 1 && MPR121_LOG_BLOCK_SCANS <= 255, "MPR121_LOG_BLOCK_SCANS must be 1-255");
+static_assert(MPR121_LOG_MAX_INDEX >= 2 && MPR121_LOG_MAX_INDEX <= 255, "MPR121_LOG_MAX_INDEX must be 2-255");
+
+//*****************************************************************************************************************************
+// 計測値記録
+class MPR121Logger {
+public:
+  static const uint8_t version = 1;      // 形式バージョン
+  static const uint8_t blockScans = MPR121_LOG_BLOCK_SCANS;  // 1ブロックのスキャン数
+  static const uint8_t maxIndex = MPR121_LOG_MAX_INDEX;      // 索引の最大件数
+  static const uint8_t maxPort = 12;     // 基板上の接続可能ポート数
+
+  MPR121Logger(Print& setOutput);                                     // コンストラクタ
+  void begin(uint16_t setPortMask);                                   // ファイルヘッダーを書き込む
+  void log(uint64_t time, const uint16_t* values, uint16_t touched);  // 1スキャン分を記録
+  void log(MPR121Manager& manager);                                   // 直近のupdate()の結果を記録
+  void flush();                                                       // 途中のブロックを書き込む
+  void finish();                                                      // 途中のブロックと索引を書き込む
+  uint32_t getBytesWritten();                                         // 書き込んだバイト数
+
+private:
+  // 索引
+  struct IndexEntry {
+    uint64_t time;    // ブロックの先頭時刻[us]
+    uint32_t offset;  // ブロックのファイル位置
+  };
+
+  Print& output;                                // 出力先（SDのFileなど）
+  uint16_t portMask = 0;                        // 使用ポートのビットマスク
+  uint8_t ports = 0;                            // 使用ポート数
+  uint32_t written = 0;                         // 書き込んだバイト数
+  uint32_t blocks = 0;                          // 書き込んだブロック数
+
+  // ブロックのバッファ
+  uint8_t count = 0;                            // バッファ中のスキャン数
+  uint64_t blockTime = 0;                       // ブロックの先頭時刻[us]
+  uint64_t lastTime = 0;                        // 前スキャンの時刻[us]
+  uint32_t delta[blockScans];                   // 前スキャンからの経過時間[us]
+  uint16_t touchMask[blockScans];               // タッチ状態
+  uint16_t value[blockScans][maxPort];          // 計測値（使用ポートを詰めて格納）
+
+  // 疎な索引
+  IndexEntry index[maxIndex];                   // 索引
+  uint8_t indexCount = 0;                       // 索引の件数
+  uint16_t indexStride = 1;                     // 索引に登録するブロックの間隔
+
+  // micros()の桁あふれ補正
+  uint32_t lastMicros = 0;                      // 前回のmicros()
+  uint64_t microsHigh = 0;                      // 桁あふれの累計
+
+  void put(uint8_t data, bool write);           // 1バイト出力（writeがfalseの場合は数えるのみ）
+  void putVarint(uint32_t data, bool write);    // 可変長整数を出力
+  uint16_t encodeBlock(bool write);             // ブロックのデータを出力してデータ長を返す
+  void addIndex();                              // 書き込むブロックを索引に登録
+};
+
+#endif
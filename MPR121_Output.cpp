@@ -0,0 +1,87 @@
+
+#include "MPR121_Output.h"
+
+//*****************************************************************************************************************************
+/**
+ * @brief コンストラクタ
+ * @param setOutput MIDIメッセージの出力先（31250bpsで開始したSerial1など）
+ * @param setChannel MIDIチャンネル（0～15）
+ */
+//*****************************************************************************************************************************
+MPR121MidiOut::MPR121MidiOut(Print& setOutput, uint8_t setChannel)
+  : output(setOutput), channel(setChannel & 0x0F) {
+  // ノート番号の初期設定（ポート0を中央ドとして半音ずつ割り当て）
+  for (uint8_t i = 0; i < maxPort; i++) {
+    note[i] = 60 + i;
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief タッチでノートオン、リリースでノートオフを送信する
+ * @param event タッチイベント
+ * @details earlyNoteが有効な場合は仮タッチでノートオンし、取り消し時にノートオフする
+ */
+//*****************************************************************************************************************************
+void MPR121MidiOut::onEvent(const MPR121Event& event) {
+  if (event.port >= maxPort) return;
+
+  bool on = (sounding >> event.port) & 1;
+  switch (event.type) {
+    case MPR121Event::TOUCH_BEGIN:
+    case MPR121Event::TOUCH:
+      // 仮タッチは有効時のみノートオン（仮タッチで送信済みの場合は確定時に重ねて送信しない）
+      if (event.type == MPR121Event::TOUCH_BEGIN && !earlyNote) break;
+      if (!on) {
+        send(0x90, event.port, event.velocity);
+        sounding |= (1 << event.port);
+      }
+      break;
+    case MPR121Event::TOUCH_CANCEL:
+    case MPR121Event::RELEASE:
+      if (on) {
+        send(0x80, event.port, event.velocity);
+        sounding &= ~(1 << event.port);
+      }
+      break;
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief MIDIメッセージ（3バイト）を送信する
+ * @param status ステータスバイト（チャンネルを除く）
+ * @param port 対象のポート番号
+ * @param velocity ベロシティ
+ */
+//*****************************************************************************************************************************
+void MPR121MidiOut::send(uint8_t status, uint8_t port, uint8_t velocity) {
+  uint8_t message[3];
+  message[0] = status | channel;
+  message[1] = note[port] & 0x7F;
+  message[2] = velocity & 0x7F;
+  output.write(message, 3);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 仮タッチ（TOUCH_BEGIN）の時点でノートオンするかを設定する
+ * @param enable trueで仮タッチ時にノートオン
+ */
+//*****************************************************************************************************************************
+void MPR121MidiOut::setEarlyNote(bool enable) {
+  earlyNote = enable;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 指定ポートに対応するノート番号を設定する
+ * @param port 対象のポート番号
+ * @param number ノート番号（0～127）
+ */
+//*****************************************************************************************************************************
+void MPR121MidiOut::setNote(uint8_t port, uint8_t number) {
+  if (port < maxPort) {
+    note[port] = number & 0x7F;
+  }
+}
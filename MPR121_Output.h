@@ -0,0 +1,83 @@
+/**
+ * @file MPR121_Output
+ * @brief 静電センサーのタッチイベント出力
+ * @details MPR121Manager::update()の判定処理内で発生したタッチ／リリースを、MIDIやキーボード(HID)に直接出力する
+ *
+ * @section 使い方
+ * - 出力先を作成し、MPR121Manager::setEventSink()で登録する
+ *    MPR121MidiOut midiOut(Serial1);   // MIDI（31250bps）で出力
+ *    mpr121.setEventSink(&midiOut);
+ *
+ * - 先行タッチ検出（MPR121Manager::setPredictSlope）を有効にすると、確定前にTOUCH_BEGINが出力される
+ *    MPR121MidiOut::setEarlyNote(true)でTOUCH_BEGIN時にノートオンし、TOUCH_CANCEL時にノートオフする。
+ *
+ * - 基板の切断・再キャリブレーションなど判定によらずタッチを解除した場合も、タッチ中のポートはRELEASE、
+ *    仮タッチ中のポートはTOUCH_CANCELを出力するため、ノートやキーが押されたまま残ることはない。
+ *
+ * @section ベロシティ
+ * - タッチ確定までの間に観測したセンサー値の1回あたりの最大変化量から求める
+ *    変化量がtouchMarginと同じ場合に127となり、ゆっくり触れるほど小さくなる（最小1）。
+ */
+
+// インクルードガード
+#ifndef MPR121_OUTPUT_H
+#define MPR121_OUTPUT_H
+
+#include <Arduino.h>       // Arduinoライブラリ
+#include "MPR121_Event.h"  // タッチイベント
+
+//*****************************************************************************************************************************
+// MIDI出力
+class MPR121MidiOut : public MPR121EventSink {
+public:
+  MPR121MidiOut(Print& setOutput, uint8_t setChannel = 0);  // コンストラクタ
+  void onEvent(const MPR121Event& event) override;           // ノートオン／オフを送信
+  void setNote(uint8_t port, uint8_t number);                // ポートに対応するノート番号を設定
+  void setEarlyNote(bool enable);                            // 仮タッチでノートオンするか設定
+
+private:
+  static const uint8_t maxPort = 12;  // 基板上の接続可能ポート数
+  Print& output;                      // 出力先（Serial1など）
+  uint8_t channel;                    // MIDIチャンネル（0～15）
+  uint8_t note[maxPort];              // 各ポートのノート番号
+  bool earlyNote = false;             // 仮タッチでノートオンするか
+  uint16_t sounding = 0;              // ノートオン中のポートをビットで格納
+  void send(uint8_t status, uint8_t port, uint8_t velocity);  // MIDIメッセージを送信
+};
+
+//*****************************************************************************************************************************
+// キーボード(HID)出力
+// press()／release()を持つキーボードクラス（Keyboard_、USBHIDKeyboardなど）を指定して使用する
+template <class Keyboard>
+class MPR121KeyOut : public MPR121EventSink {
+public:
+  // コンストラクタ
+  MPR121KeyOut(Keyboard& setKeyboard)
+    : keyboard(setKeyboard) {
+    for (uint8_t i = 0; i < maxPort; i++) {
+      key[i] = 0;
+    }
+  }
+
+  // キーの押下／解放を送信
+  void onEvent(const MPR121Event& event) override {
+    if (event.port >= maxPort || key[event.port] == 0) return;
+    if (event.type == MPR121Event::TOUCH) {
+      keyboard.press(key[event.port]);
+    } else if (event.type == MPR121Event::RELEASE) {
+      keyboard.release(key[event.port]);
+    }
+  }
+
+  // ポートに対応するキーを設定（0で出力しない）
+  void setKey(uint8_t port, uint8_t code) {
+    if (port < maxPort) key[port] = code;
+  }
+
+private:
+  static const uint8_t maxPort = 12;  // 基板上の接続可能ポート数
+  Keyboard& keyboard;                 // 出力先キーボード
+  uint8_t key[maxPort];               // 各ポートのキーコード
+};
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ * @file Adafruit_MPR121.h（ホスト用）
+ * @brief PC上で使用するAdafruit_MPR121互換クラス
+ * @details MPR121Managerが使用する関数のみを、ホスト用のTwoWire上に実装する。
+ *          レジスタ書き込み時の停止モードへの切り替えなど、動作はAdafruitライブラリに合わせている。
+ */
+
+// インクルードガード
+#ifndef HOST_ADAFRUIT_MPR121_H
+#define HOST_ADAFRUIT_MPR121_H
+
+#include "Arduino.h"
+#include "Wire.h"
+
+#define MPR121_I2CADDR_DEFAULT 0x5A         // デフォルトのI2Cアドレス
+#define MPR121_TOUCH_THRESHOLD_DEFAULT 12   // タッチ閾値の初期値
+#define MPR121_RELEASE_THRESHOLD_DEFAULT 6  // リリース閾値の初期値
+
+// レジスタアドレス
+enum {
+  MPR121_TOUCHSTATUS_L = 0x00,
+  MPR121_TOUCHSTATUS_H = 0x01,
+  MPR121_FILTDATA_0L = 0x04,
+  MPR121_FILTDATA_0H = 0x05,
+  MPR121_BASELINE_0 = 0x1E,
+  MPR121_MHDR = 0x2B,
+  MPR121_NHDR = 0x2C,
+  MPR121_NCLR = 0x2D,
+  MPR121_FDLR = 0x2E,
+  MPR121_MHDF = 0x2F,
+  MPR121_NHDF = 0x30,
+  MPR121_NCLF = 0x31,
+  MPR121_FDLF = 0x32,
+  MPR121_NHDT = 0x33,
+  MPR121_NCLT = 0x34,
+  MPR121_FDLT = 0x35,
+  MPR121_TOUCHTH_0 = 0x41,
+  MPR121_RELEASETH_0 = 0x42,
+  MPR121_DEBOUNCE = 0x5B,
+  MPR121_CONFIG1 = 0x5C,
+  MPR121_CONFIG2 = 0x5D,
+  MPR121_CHARGECURR_0 = 0x5F,
+  MPR121_CHARGETIME_1 = 0x6C,
+  MPR121_ECR = 0x5E,
+  MPR121_AUTOCONFIG0 = 0x7B,
+  MPR121_AUTOCONFIG1 = 0x7C,
+  MPR121_UPLIMIT = 0x7D,
+  MPR121_LOWLIMIT = 0x7E,
+  MPR121_TARGETLIMIT = 0x7F,
+  MPR121_GPIODIR = 0x76,
+  MPR121_GPIOEN = 0x77,
+  MPR121_GPIOSET = 0x78,
+  MPR121_GPIOCLR = 0x79,
+  MPR121_GPIOTOGGLE = 0x7A,
+  MPR121_SOFTRESET = 0x80,
+};
+
+//*****************************************************************************************************************************
+// Adafruit_MPR121互換クラス
+class Adafruit_MPR121 {
+public:
+  // 初期化（ソフトリセット後に既定の設定を書き込む）
+  bool begin(uint8_t i2caddr = MPR121_I2CADDR_DEFAULT, TwoWire* theWire = &Wire,
+             uint8_t touchThreshold = MPR121_TOUCH_THRESHOLD_DEFAULT,
+             uint8_t releaseThreshold = MPR121_RELEASE_THRESHOLD_DEFAULT) {
+    address = i2caddr;
+    wire = theWire;
+    wire->begin();
+
+    writeRegister(MPR121_SOFTRESET, 0x63);
+    delay(1);
+    writeRegister(MPR121_ECR, 0x00);
+
+    // リセット後のCONFIG2の値で接続を確認
+    if (readRegister8(MPR121_CONFIG2) != 0x24) return false;
+
+    setThresholds(touchThreshold, releaseThreshold);
+    writeRegister(MPR121_MHDR, 0x01);
+    writeRegister(MPR121_NHDR, 0x01);
+    writeRegister(MPR121_NCLR, 0x0E);
+    writeRegister(MPR121_FDLR, 0x00);
+    writeRegister(MPR121_MHDF, 0x01);
+    writeRegister(MPR121_NHDF, 0x05);
+    writeRegister(MPR121_NCLF, 0x01);
+    writeRegister(MPR121_FDLF, 0x00);
+    writeRegister(MPR121_NHDT, 0x00);
+    writeRegister(MPR121_NCLT, 0x00);
+    writeRegister(MPR121_FDLT, 0x00);
+    writeRegister(MPR121_DEBOUNCE, 0);
+    writeRegister(MPR121_CONFIG1, 0x10);
+    writeRegister(MPR121_CONFIG2, 0x20);
+
+    // 計測開始（ベースライン追従あり、12電極）
+    writeRegister(MPR121_ECR, 0x8C);
+    return true;
+  }
+
+  void setThresholds(uint8_t touch, uint8_t release) {
+    for (uint8_t i = 0; i < 12; i++) {
+      writeRegister(MPR121_TOUCHTH_0 + 2 * i, touch);
+      writeRegister(MPR121_RELEASETH_0 + 2 * i, release);
+    }
+  }
+
+  uint16_t filteredData(uint8_t t) {
+    if (t > 12) return 0;
+    return readRegister16(MPR121_FILTDATA_0L + t * 2);
+  }
+
+  uint16_t baselineData(uint8_t t) {
+    if (t > 12) return 0;
+    return readRegister8(MPR121_BASELINE_0 + t) << 2;
+  }
+
+  uint16_t touched() {
+    return readRegister16(MPR121_TOUCHSTATUS_L) & 0x0FFF;
+  }
+
+  uint8_t readRegister8(uint8_t reg) {
+    uint8_t data = 0;
+    readRegisters(reg, &data, 1);
+    return data;
+  }
+
+  uint16_t readRegister16(uint8_t reg) {
+    uint8_t data[2] = { 0, 0 };
+    readRegisters(reg, data, 2);
+    return data[0] | (data[1] << 8);
+  }
+
+  // 書き込み（計測中は停止モードに切り替えてから書き込み、元に戻す）
+  void writeRegister(uint8_t reg, uint8_t value) {
+    bool stopRequired = !(reg == MPR121_ECR || (0x73 <= reg && reg <= 0x7A));
+    uint8_t ecrBackup = stopRequired ? readRegister8(MPR121_ECR) : 0;
+    if (stopRequired && ecrBackup != 0) write(MPR121_ECR, 0x00);
+    write(reg, value);
+    if (stopRequired && ecrBackup != 0) write(MPR121_ECR, ecrBackup);
+  }
+
+private:
+  TwoWire* wire = &Wire;                     // 接続先のI2Cバス
+  uint8_t address = MPR121_I2CADDR_DEFAULT;  // I2Cアドレス
+
+  void write(uint8_t reg, uint8_t value) {
+    wire->beginTransmission(address);
+    wire->write(reg);
+    wire->write(value);
+    wire->endTransmission();
+  }
+
+  void readRegisters(uint8_t reg, uint8_t* data, uint8_t length) {
+    wire->beginTransmission(address);
+    wire->write(reg);
+    wire->endTransmission(false);
+    if (wire->requestFrom(address, length) != length) return;
+    for (uint8_t n = 0; n < length; n++) data[n] = wire->read();
+  }
+};
+
+#endif
@@ -0,0 +1,152 @@
+/**
+ * @file Arduino.h（ホスト用）
+ * @brief PC上でMPR121Managerを動かすためのArduino互換定義
+ * @details シミュレーター・解析ツールからスケッチのソースをそのままビルドするために使用する。
+ *          時刻は実時間、またはHostClock::simulatedを有効にした場合は仮想時刻を返す。
+ */
+
+// インクルードガード
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#define HEX 16
+#define DEC 10
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+//*****************************************************************************************************************************
+// 時刻管理
+namespace HostClock {
+inline bool simulated = false;  // trueで仮想時刻を使用
+inline uint64_t now = 0;        // 仮想時刻[us]
+
+// 現在時刻[us]
+inline uint64_t micros64() {
+  if (simulated) return now;
+  static const auto start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 仮想時刻を進める
+inline void advance(uint64_t us) {
+  now += us;
+}
+}
+
+inline unsigned long millis() {
+  return (unsigned long)(HostClock::micros64() / 1000);
+}
+
+inline unsigned long micros() {
+  return (unsigned long)HostClock::micros64();
+}
+
+inline void delay(unsigned long ms) {
+  if (HostClock::simulated) HostClock::advance((uint64_t)ms * 1000);
+  else std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void delayMicroseconds(unsigned int us) {
+  if (HostClock::simulated) HostClock::advance(us);
+  else std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+//*****************************************************************************************************************************
+// 文字列
+class String : public std::string {
+public:
+  using std::string::string;
+  String() {}
+  String(const std::string& text)
+    : std::string(text) {}
+};
+
+//*****************************************************************************************************************************
+// 文字出力
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    for (size_t n = 0; n < size; n++) write(buffer[n]);
+    return size;
+  }
+
+  size_t print(const char* text) {
+    return write((const uint8_t*)text, strlen(text));
+  }
+  size_t print(const String& text) {
+    return write((const uint8_t*)text.data(), text.size());
+  }
+  size_t print(char c) {
+    return write((uint8_t)c);
+  }
+  size_t print(unsigned char n, int base = DEC) {
+    return print((unsigned long)n, base);
+  }
+  size_t print(int n, int base = DEC) {
+    return print((long)n, base);
+  }
+  size_t print(unsigned int n, int base = DEC) {
+    return print((unsigned long)n, base);
+  }
+  size_t print(long n, int base = DEC) {
+    if (n < 0 && base == DEC) return print('-') + print((unsigned long)-n, base);
+    return print((unsigned long)n, base);
+  }
+  size_t print(unsigned long n, int base = DEC) {
+    char text[24];
+    snprintf(text, sizeof(text), base == HEX ? "%lX" : "%lu", n);
+    return print(text);
+  }
+  size_t print(double n, int digits = 2) {
+    char text[48];
+    snprintf(text, sizeof(text), "%.*f", digits, n);
+    return print(text);
+  }
+
+  size_t println() {
+    return print("\r\n");
+  }
+  template <class T>
+  size_t println(const T& value) {
+    return print(value) + println();
+  }
+};
+
+//*****************************************************************************************************************************
+// 入出力ストリーム
+class Stream : public Print {
+public:
+  virtual int available() {
+    return 0;
+  }
+  virtual int read() {
+    return -1;
+  }
+};
+
+//*****************************************************************************************************************************
+// シリアル（標準出力に出力）
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t c) override {
+    return fputc(c, stdout) == EOF ? 0 : 1;
+  }
+  size_t write(const uint8_t* buffer, size_t size) override {
+    return fwrite(buffer, 1, size, stdout);
+  }
+};
+
+inline HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,271 @@
+/**
+ * @file LinuxI2C
+ * @brief Linuxのi2c-dev（/dev/i2c-N）を使用するI2Cバス
+ * @details Linuxのシングルボードコンピューター上でMPR121Managerを動かすためのI2CBus実装。
+ *          書き込みと読み出しはI2C_RDWRで1回のioctlにまとめ、リピートスタートで転送する。
+ *          実機がない環境では、ioctlの代わりに模擬MPR121へ転送するI2CDevStandInで同じ経路を確認できる。
+ *          MPR121BatchUpdateを使用すると、全基板の状態・計測値・ベースラインの読み出しを1回のioctlにまとめられる。
+ *
+ * @section 使い方
+ *    LinuxI2CBus bus;
+ *    bus.open("/dev/i2c-1");
+ *    TwoWire wire(&bus);
+ *    MPR121Manager mpr121(0x5A, 0x0FFF, &wire);
+ *
+ *    MPR121BatchUpdate batch(bus);       // 複数基板をまとめて更新する場合
+ *    batch.add(mpr121);
+ *    batch.update();                     // 各基板のupdate()の代わりに呼ぶ
+ */
+
+// インクルードガード
+#ifndef LINUX_I2C_H
+#define LINUX_I2C_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "MPR121_Config.h"
+#include "MPR121_Mock.h"
+
+//*****************************************************************************************************************************
+// i2c-devのI2Cバス
+class LinuxI2CBus : public I2CBus {
+public:
+  // 転送の統計
+  struct Stats {
+    uint64_t ioctls = 0;     // ioctlの呼び出し回数
+    uint64_t messages = 0;   // 転送したメッセージ数
+    uint64_t bytes = 0;      // 転送したデータのバイト数
+    uint64_t nacks = 0;      // 応答なし（ENXIO／EREMOTEIO）の回数
+    uint64_t errors = 0;     // その他のエラー回数
+  };
+
+  LinuxI2CBus() {}
+  LinuxI2CBus(const LinuxI2CBus&) = delete;
+  LinuxI2CBus& operator=(const LinuxI2CBus&) = delete;
+  virtual ~LinuxI2CBus() {
+    close();
+  }
+
+  /**
+   * @brief i2c-devのデバイスファイルを開く
+   * @param path デバイスファイル（/dev/i2c-1など）
+   * @return 開くことができ、I2C_RDWRに対応している場合true
+   */
+  bool open(const std::string& path) {
+    close();
+    fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) return false;
+    unsigned long functions = 0;
+    if (ioctl(fd, I2C_FUNCS, &functions) != 0 || !(functions & I2C_FUNC_I2C)) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+  }
+
+  const Stats& getStats() const {
+    return stats;
+  }
+
+  uint8_t transfer(uint8_t address, const uint8_t* writeData, size_t writeLength, uint8_t* readData, size_t readLength) override {
+    // 書き込み（レジスタ指定）と読み出しをリピートスタートでつなぐ
+    i2c_msg messages[2];
+    uint32_t count = 0;
+    if (writeLength > 0 || readLength == 0) {
+      messages[count++] = { address, 0, (uint16_t)writeLength, const_cast<uint8_t*>(writeData) };
+    }
+    if (readLength > 0) {
+      messages[count++] = { address, I2C_M_RD, (uint16_t)readLength, readData };
+    }
+    return transferMessages(messages, count);
+  }
+
+  /**
+   * @brief 複数のメッセージを1回のI2C_RDWRで転送する
+   * @param messages メッセージ列（I2C_RDWR_IOCTL_MAX_MSGS個まで）
+   * @param count メッセージ数
+   * @return transfer()と同じ（いずれかのメッセージが失敗した場合は全体が失敗となる）
+   */
+  uint8_t transferMessages(i2c_msg* messages, uint32_t count) {
+    stats.ioctls++;
+    stats.messages += count;
+    if (rdwr(messages, count) < 0) {
+      if (errno == ENXIO || errno == EREMOTEIO) {
+        stats.nacks++;
+        return 2;
+      }
+      stats.errors++;
+      return 4;
+    }
+    for (uint32_t n = 0; n < count; n++) stats.bytes += messages[n].len;
+    return 0;
+  }
+
+protected:
+  int fd = -1;  // デバイスファイル
+  Stats stats;  // 転送の統計
+
+  /**
+   * @brief メッセージ列を1回の転送（I2C_RDWR）で実行する
+   * @return 成功した場合は0以上、失敗した場合は-1（errnoに理由）
+   */
+  virtual int rdwr(i2c_msg* messages, uint32_t count) {
+    i2c_rdwr_ioctl_data data = { messages, count };
+    return ioctl(fd, I2C_RDWR, &data);
+  }
+};
+
+//*****************************************************************************************************************************
+// i2c-devの代わりに模擬MPR121へ転送するバス（実機なしでの動作確認用）
+class I2CDevStandIn : public LinuxI2CBus {
+public:
+  static const uint32_t maxMessages = I2C_RDWR_IOCTL_MAX_MSGS;  // 1回のI2C_RDWRで扱えるメッセージ数（カーネルと同じ）
+
+  // 模擬デバイスを接続
+  void attach(MPR121Mock* device) {
+    devices.push_back({ device, true });
+  }
+
+  // 指定アドレスの模擬デバイスの接続状態を切り替える（抜き差しの模擬）
+  void setConnected(uint8_t address, bool connected) {
+    for (Slot& slot : devices) {
+      if (slot.device->getAddress() == address) slot.connected = connected;
+    }
+  }
+
+protected:
+  // カーネルと同じ条件で検査し、書き込みに続く同じアドレスの読み出しはリピートスタートとして1回のアクセスにまとめる
+  int rdwr(i2c_msg* messages, uint32_t count) override {
+    if (count == 0 || count > maxMessages) {
+      errno = EINVAL;
+      return -1;
+    }
+    for (uint32_t n = 0; n < count; n++) {
+      if (messages[n].len > 8192 || (messages[n].len > 0 && messages[n].buf == nullptr)) {
+        errno = EINVAL;
+        return -1;
+      }
+    }
+
+    for (uint32_t n = 0; n < count; n++) {
+      MPR121Mock* device = find(messages[n].addr);
+      if (device == nullptr) {
+        errno = ENXIO;
+        return -1;
+      }
+      bool read = messages[n].flags & I2C_M_RD;
+      if (!read && n + 1 < count && (messages[n + 1].flags & I2C_M_RD) && messages[n + 1].addr == messages[n].addr) {
+        device->access(messages[n].buf, messages[n].len, messages[n + 1].buf, messages[n + 1].len);
+        n++;
+      } else if (read) {
+        device->access(nullptr, 0, messages[n].buf, messages[n].len);
+      } else {
+        device->access(messages[n].buf, messages[n].len, nullptr, 0);
+      }
+    }
+    return (int)count;
+  }
+
+private:
+  struct Slot {
+    MPR121Mock* device;  // 模擬デバイス
+    bool connected;      // 接続状態
+  };
+  std::vector<Slot> devices;  // 接続した模擬デバイス
+
+  MPR121Mock* find(uint16_t address) {
+    for (Slot& slot : devices) {
+      if (slot.connected && slot.device->getAddress() == address) return slot.device;
+    }
+    return nullptr;
+  }
+};
+
+//*****************************************************************************************************************************
+// 複数基板の一括更新（全基板の読み出しを1回のI2C_RDWRにまとめる）
+class MPR121BatchUpdate {
+public:
+  static const uint8_t maxBoards = I2C_RDWR_IOCTL_MAX_MSGS / 2;  // 1回のioctlで読み出せる基板数（1基板2メッセージ）
+
+  // 更新の統計
+  struct Stats {
+    uint64_t updates = 0;    // update()の回数
+    uint64_t batches = 0;    // まとめて転送したioctlの回数
+    uint64_t fallbacks = 0;  // 一括転送の失敗により基板ごとに読み直した回数
+  };
+
+  MPR121BatchUpdate(LinuxI2CBus& setBus)
+    : bus(setBus) {}
+
+  // 基板を追加（読み出し先はマネージャーのI2Cアドレス）
+  void add(MPR121Manager& manager) {
+    boards.push_back({ &manager });
+  }
+
+  const Stats& getStats() const {
+    return stats;
+  }
+
+  /**
+   * @brief 全基板を更新する
+   * @details 各基板の読み出し範囲（レジスタ指定の書き込み＋読み出し）を並べて1回のioctlで転送する。
+   *          I2C_RDWRはいずれかの基板が応答しないと全体が失敗するため、その場合は基板ごとに読み直して
+   *          応答しない基板のみを読み出し失敗とする。
+   */
+  void update() {
+    stats.updates++;
+    for (size_t first = 0; first < boards.size(); first += maxBoards) {
+      size_t last = std::min(boards.size(), first + maxBoards);
+
+      // 読み出しが必要な基板のメッセージを並べる
+      i2c_msg messages[maxBoards * 2];
+      uint32_t count = 0;
+      for (size_t b = first; b < last; b++) {
+        Board& board = boards[b];
+        board.pending = board.manager->getBurstRange(board.reg, board.length);
+        if (!board.pending) continue;
+        uint8_t address = board.manager->getAddress();
+        messages[count++] = { address, 0, 1, &board.reg };
+        messages[count++] = { address, I2C_M_RD, board.length, board.buffer };
+      }
+      if (count == 0) continue;
+
+      stats.batches++;
+      bool received = bus.transferMessages(messages, count) == 0;
+      if (!received) stats.fallbacks++;
+      for (size_t b = first; b < last; b++) {
+        Board& board = boards[b];
+        if (!board.pending) continue;
+        bool ok = received || bus.transfer(board.manager->getAddress(), &board.reg, 1, board.buffer, board.length) == 0;
+        board.manager->updateFromBurst(board.buffer, ok);
+      }
+    }
+  }
+
+private:
+  struct Board {
+    MPR121Manager* manager;                        // 基板のマネージャー
+    uint8_t reg = 0;                               // 読み出し開始レジスタ
+    uint8_t length = 0;                            // 読み出すバイト数
+    bool pending = false;                          // 今回読み出すか
+    uint8_t buffer[MPR121Manager::burstSize] = {}; // 読み出した値
+  };
+
+  LinuxI2CBus& bus;           // 転送先
+  std::vector<Board> boards;  // 基板
+  Stats stats;                // 統計
+};
+
+#endif
@@ -0,0 +1,265 @@
+/**
+ * @file LogReader
+ * @brief MPR121Loggerで記録したファイルの読み出し（PC用）
+ * @details ファイルをメモリマップし、ブロック単位で復元する。索引（finish()で書き込まれたもの）があれば
+ *          索引から、なければブロックヘッダーをたどって目的の時刻のブロックを探すため、
+ *          長時間の記録でも任意の時間範囲だけを読み出せる。形式は MPR121_Log.h を参照。
+ */
+
+// インクルードガード
+#ifndef LOG_READER_H
+#define LOG_READER_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "Trace.h"
+
+//*****************************************************************************************************************************
+// 記録ファイルの読み出し
+class LogReader {
+public:
+  static const size_t headerSize = 12;       // ファイルヘッダーのサイズ
+  static const size_t blockHeaderSize = 12;  // ブロックヘッダーのサイズ
+
+  // ブロック
+  struct Block {
+    size_t offset = 0;              // ファイル位置
+    uint64_t time = 0;              // 先頭時刻[us]
+    uint8_t scans = 0;              // スキャン数
+    uint16_t length = 0;            // データ長
+    const uint8_t* data = nullptr;  // データ（メモリマップ上）
+  };
+
+  LogReader() {}
+  LogReader(const LogReader&) = delete;
+  LogReader& operator=(const LogReader&) = delete;
+  ~LogReader() {
+    close();
+  }
+
+  /**
+   * @brief ファイルを開いてメモリマップする
+   * @return MPR121Loggerの記録ファイルとして読み出せる場合true
+   */
+  bool open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)headerSize) {
+      ::close(fd);
+      return false;
+    }
+    size = info.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+      size = 0;
+      return false;
+    }
+    base = (const uint8_t*)mapped;
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    if (memcmp(base, "M121LOG", 7) != 0 || base[7] != 1) {
+      close();
+      return false;
+    }
+    portMask = base[8] | (base[9] << 8);
+    ports = base[10];
+    end = size;
+    loadIndex();
+    return true;
+  }
+
+  void close() {
+    if (base != nullptr) munmap((void*)base, size);
+    base = nullptr;
+    size = 0;
+    end = 0;
+    index.clear();
+  }
+
+  uint16_t getPortMask() const {
+    return portMask;
+  }
+
+  // 索引（finish()で書き込まれたもの）があるか
+  bool hasIndex() const {
+    return indexed;
+  }
+
+  // 記録部分のサイズ[バイト]
+  size_t getDataSize() const {
+    return end;
+  }
+
+  /**
+   * @brief 指定位置のブロックヘッダーを読み取る
+   * @return ブロックが完全に記録されている場合true（電源断などで途中までの場合はfalse）
+   */
+  bool blockAt(size_t offset, Block& block) const {
+    if (offset + blockHeaderSize > end || base[offset] != 'B') return false;
+    const uint8_t* p = base + offset;
+    block.offset = offset;
+    block.scans = p[1];
+    block.length = p[2] | (p[3] << 8);
+    block.time = 0;
+    for (int n = 7; n >= 0; n--) block.time = (block.time << 8) | p[4 + n];
+    block.data = p + blockHeaderSize;
+    return offset + blockHeaderSize + block.length <= end;
+  }
+
+  // 先頭のブロック
+  bool first(Block& block) const {
+    return blockAt(headerSize, block);
+  }
+
+  // 次のブロック
+  bool next(Block& block) const {
+    return blockAt(block.offset + blockHeaderSize + block.length, block);
+  }
+
+  /**
+   * @brief 指定時刻を含むブロック（先頭時刻が指定時刻以下の最後のブロック）を探す
+   * @details 索引で近くのブロックまで移動し、そこからブロックヘッダーをたどる
+   */
+  bool seek(uint64_t time, Block& block) const {
+    size_t offset = headerSize;
+    for (const Entry& entry : index) {
+      if (entry.time > time) break;
+      offset = entry.offset;
+    }
+    if (!blockAt(offset, block)) return false;
+
+    Block following = block;
+    while (next(following) && following.time <= time) block = following;
+    return true;
+  }
+
+  /**
+   * @brief ブロックを復元してトレースの末尾に追加する
+   */
+  void decode(const Block& block, Trace& trace) const {
+    const uint8_t* p = block.data;
+    const uint8_t* limit = block.data + block.length;
+    size_t first = trace.size();
+
+    // 時刻列
+    uint64_t time = block.time;
+    for (uint8_t s = 0; s < block.scans; s++) {
+      if (s > 0) time += varint(p, limit);
+      trace.time.push_back(time);
+    }
+
+    // タッチ列
+    uint16_t mask = 0;
+    for (uint8_t s = 0; s < block.scans; s++) {
+      mask ^= (uint16_t)varint(p, limit);
+      trace.touch.push_back(mask);
+    }
+
+    // 計測値列（使用ポート以外は0）
+    trace.filtered.resize((first + block.scans) * Trace::maxPort, 0);
+    for (uint8_t port = 0; port < Trace::maxPort; port++) {
+      if (!((portMask >> port) & 1)) continue;
+      int32_t value = 0;
+      for (uint8_t s = 0; s < block.scans; s++) {
+        uint32_t zigzag = varint(p, limit);
+        value += (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+        trace.filtered[(first + s) * Trace::maxPort + port] = (uint16_t)value;
+      }
+    }
+  }
+
+  /**
+   * @brief 指定時間範囲のスキャンを読み出す
+   * @param start 開始時刻[us]
+   * @param stop 終了時刻[us]（この時刻のスキャンは含まない）
+   * @param trace 読み出し先（正解ラベルは記録されたタッチ状態から作成）
+   * @return 読み出したスキャン数
+   */
+  size_t read(uint64_t start, uint64_t stop, Trace& trace) const {
+    trace = Trace();
+    trace.portMask = portMask;
+    Block block;
+    if (!seek(start, block)) return 0;
+
+    Trace decoded;
+    do {
+      if (block.time >= stop) break;
+      decoded = Trace();
+      decode(block, decoded);
+      for (size_t n = 0; n < decoded.size(); n++) {
+        if (decoded.time[n] < start || decoded.time[n] >= stop) continue;
+        trace.time.push_back(decoded.time[n]);
+        trace.touch.push_back(decoded.touch[n]);
+        trace.filtered.insert(trace.filtered.end(), decoded.filteredAt(n), decoded.filteredAt(n) + Trace::maxPort);
+      }
+    } while (next(block));
+
+    trace.buildLabels();
+    return trace.size();
+  }
+
+  // 全スキャンを読み出す
+  size_t readAll(Trace& trace) const {
+    return read(0, UINT64_MAX, trace);
+  }
+
+private:
+  // 索引
+  struct Entry {
+    uint64_t time;
+    size_t offset;
+  };
+
+  const uint8_t* base = nullptr;  // メモリマップの先頭
+  size_t size = 0;                // ファイルサイズ
+  size_t end = 0;                 // 記録部分の終端（索引の手前）
+  uint16_t portMask = 0;          // 使用ポート
+  uint8_t ports = 0;              // 使用ポート数
+  bool indexed = false;           // 索引の有無
+  std::vector<Entry> index;       // 索引
+
+  // 可変長整数を読み取る
+  static uint32_t varint(const uint8_t*& p, const uint8_t* limit) {
+    uint32_t value = 0;
+    for (int shift = 0; p < limit && shift < 35; shift += 7) {
+      uint8_t data = *p++;
+      value |= (uint32_t)(data & 0x7F) << shift;
+      if (!(data & 0x80)) break;
+    }
+    return value;
+  }
+
+  // 末尾の索引を読み込む（なければブロックヘッダーをたどる）
+  void loadIndex() {
+    indexed = false;
+    index.clear();
+    if (size >= headerSize + 8 && memcmp(base + size - 4, "MIDX", 4) == 0) {
+      const uint8_t* p = base + size - 8;
+      size_t offset = p[0] | (p[1] << 8) | (p[2] << 16) | ((size_t)p[3] << 24);
+      if (offset + 4 <= size - 8 && base[offset] == 'I') {
+        uint8_t count = base[offset + 1];
+        if (offset + 4 + count * 12 + 8 == size) {
+          const uint8_t* q = base + offset + 4;
+          for (uint8_t i = 0; i < count; i++, q += 12) {
+            Entry entry = { 0, 0 };
+            for (int n = 7; n >= 0; n--) entry.time = (entry.time << 8) | q[n];
+            entry.offset = q[8] | (q[9] << 8) | (q[10] << 16) | ((size_t)q[11] << 24);
+            index.push_back(entry);
+          }
+          end = offset;
+          indexed = true;
+          return;
+        }
+      }
+    }
+  }
+};
+
+#endif
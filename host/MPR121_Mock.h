@@ -0,0 +1,211 @@
+/**
+ * @file MPR121_Mock
+ * @brief PC上で使用するMPR121の模擬デバイス
+ * @details レジスタ単位でMPR121の動作を模擬する。各電極の計測値は時刻を引数とする関数（Source）から取得し、
+ *          チップの計測周期（1ms）ごとに計測値・ベースライン・タッチ状態を更新する。
+ *
+ * @section 模擬している動作
+ * - ソフトリセット（0x80に0x63）、ECRによる停止／計測の切り替え
+ * - 計測開始時のベースライン初期化と、計測値への追従（上昇は即時、下降は非タッチ時に1回1ずつ）
+ * - タッチ／リリース閾値によるタッチ状態、範囲外（OOR）・過電流フラグ、自動キャリブレーションによるOORの解除
+ * - 計測中のレジスタ書き込みの無視（ECRと0x73-0x7A以外は停止中のみ書き込める）
+ * - 自動キャリブレーション実行時の上限・下限・目標値（USL／LSL／TL：0x7D-0x7F）の記録
+ */
+
+// インクルードガード
+#ifndef MPR121_MOCK_H
+#define MPR121_MOCK_H
+
+#include <functional>
+#include "Adafruit_MPR121.h"
+
+//*****************************************************************************************************************************
+// MPR121模擬デバイス
+class MPR121Mock {
+public:
+  typedef std::function<float(uint8_t electrode, uint64_t time)> Source;  // 電極の計測値（10bit）を返す関数
+
+  static const uint8_t maxPort = 12;        // 電極数
+  static const uint32_t sampleTime = 1000;  // 計測周期[us]
+
+  MPR121Mock(uint8_t setAddress = MPR121_I2CADDR_DEFAULT)
+    : address(setAddress) {
+    for (uint8_t i = 0; i < maxPort; i++) level[i] = 700;
+    reset();
+  }
+
+  uint8_t getAddress() const {
+    return address;
+  }
+
+  // 計測値を返す関数を設定（未設定の場合はsetLevel()の値）
+  void setSource(Source setSource) {
+    source = setSource;
+  }
+
+  // 指定電極の計測値を固定値で設定
+  void setLevel(uint8_t electrode, float value) {
+    if (electrode < maxPort) level[electrode] = value;
+  }
+
+  // 範囲外の電極を設定（clearOnAutoConfigがtrueの場合は自動キャリブレーションで解除される）
+  void setOutOfRange(uint16_t mask, bool clearOnAutoConfig = true) {
+    oorMask = mask & 0x0FFF;
+    oorClearable = clearOnAutoConfig;
+  }
+
+  // 過電流を発生させる（計測は停止する）
+  void setOverCurrent() {
+    overCurrent = true;
+    regs[MPR121_ECR] = 0;
+  }
+
+  uint32_t getAutoConfigCount() const {
+    return autoConfigCount;
+  }
+
+  // 直近の自動キャリブレーションで使用した上限・下限・目標値（USL／LSL／TL）
+  uint8_t getAutoConfigLimit(uint8_t reg) const {
+    return (reg >= MPR121_UPLIMIT && reg <= MPR121_TARGETLIMIT) ? autoConfigLimit[reg - MPR121_UPLIMIT] : 0;
+  }
+
+  // 指定レジスタへの書き込みが反映された順番（1から、未書き込みは0）
+  uint32_t getWriteOrder(uint8_t reg) const {
+    return writeOrder[reg];
+  }
+
+  uint8_t getRegister(uint8_t reg) const {
+    return regs[reg];
+  }
+
+  /**
+   * @brief I2Cの1回の転送を処理する
+   * @details 先頭の書き込みバイトでレジスタを指定し、続く書き込み・読み出しはアドレスを自動で進める
+   */
+  void access(const uint8_t* writeData, size_t writeLength, uint8_t* readData, size_t readLength) {
+    if (writeLength > 0) {
+      pointer = writeData[0];
+      for (size_t n = 1; n < writeLength; n++) writeRegister(pointer++, writeData[n]);
+    }
+    if (readLength > 0) {
+      sample(HostClock::micros64());
+      for (size_t n = 0; n < readLength; n++) readData[n] = readRegister(pointer++);
+    }
+  }
+
+private:
+  uint8_t address;                  // I2Cアドレス
+  uint8_t regs[256];                // レジスタ
+  uint8_t pointer = 0;              // レジスタアドレスの指定位置
+  Source source;                    // 計測値を返す関数
+  float level[maxPort];             // 固定の計測値
+  uint16_t filtered[maxPort];       // 計測値（10bit）
+  uint16_t base[maxPort];           // ベースライン（10bit）
+  uint16_t touchStatus = 0;         // タッチ状態
+  uint16_t oorMask = 0;             // 範囲外の電極
+  bool oorClearable = true;         // 自動キャリブレーションで範囲外を解除するか
+  bool overCurrent = false;         // 過電流フラグ
+  bool running = false;             // 計測中か
+  uint64_t lastSample = 0;          // 前回の計測時刻[us]
+  uint32_t autoConfigCount = 0;     // 自動キャリブレーションの実行回数
+  uint8_t autoConfigLimit[3] = {};  // 直近の自動キャリブレーションのUSL／LSL／TL
+  uint32_t writeOrder[256] = {};    // レジスタごとの最後に反映された書き込みの順番
+  uint32_t writeCount = 0;          // 反映された書き込みの回数
+
+  // ソフトリセット後の状態
+  void reset() {
+    memset(regs, 0, sizeof(regs));
+    regs[MPR121_CONFIG1] = 0x10;
+    regs[MPR121_CONFIG2] = 0x24;
+    touchStatus = 0;
+    running = false;
+    for (uint8_t i = 0; i < maxPort; i++) {
+      filtered[i] = 0;
+      base[i] = 0;
+    }
+  }
+
+  // 電極の計測値を取得
+  uint16_t measure(uint8_t electrode, uint64_t time) {
+    float value = source ? source(electrode, time) : level[electrode];
+    return (uint16_t)constrain(value + 0.5f, 0.0f, 1023.0f);
+  }
+
+  // 計測周期ごとに計測値・ベースライン・タッチ状態を更新
+  void sample(uint64_t time) {
+    if (!running || time - lastSample < sampleTime) return;
+    lastSample = time;
+
+    for (uint8_t i = 0; i < maxPort; i++) {
+      filtered[i] = measure(i, time);
+
+      int delta = (int)base[i] - filtered[i];
+      bool touched = (touchStatus >> i) & 1;
+      if (!touched && delta > regs[MPR121_TOUCHTH_0 + 2 * i]) touchStatus |= (1 << i);
+      if (touched && delta < regs[MPR121_RELEASETH_0 + 2 * i]) touchStatus &= ~(1 << i);
+
+      // ベースライン追従（ECRのCLビットが0の場合は追従しない）
+      if ((regs[MPR121_ECR] & 0xC0) == 0) continue;
+      if (delta < 0) base[i] = filtered[i];
+      else if (delta > 0 && !((touchStatus >> i) & 1)) base[i]--;
+    }
+  }
+
+  // 計測開始（ベースラインを現在値で初期化し、自動キャリブレーションを実行）
+  void start() {
+    running = true;
+    lastSample = HostClock::micros64();
+    for (uint8_t i = 0; i < maxPort; i++) {
+      filtered[i] = measure(i, lastSample);
+      base[i] = filtered[i];
+    }
+    touchStatus = 0;
+    if (regs[MPR121_AUTOCONFIG0] & 0x01) {
+      autoConfigCount++;
+      for (uint8_t n = 0; n < 3; n++) autoConfigLimit[n] = regs[MPR121_UPLIMIT + n];
+      if (oorClearable) oorMask = 0;
+    }
+  }
+
+  void writeRegister(uint8_t reg, uint8_t value) {
+    if (reg == MPR121_SOFTRESET) {
+      if (value == 0x63) reset();
+      return;
+    }
+    if (reg == MPR121_TOUCHSTATUS_H) {
+      // 過電流フラグは1を書き込んで解除
+      if (value & 0x80) overCurrent = false;
+      return;
+    }
+    if (reg < MPR121_MHDR) return;  // 計測値などは読み出し専用
+    if (running && reg != MPR121_ECR && (reg < 0x73 || reg > 0x7A)) return;  // 計測中は書き込めない
+    writeOrder[reg] = ++writeCount;
+
+    if (reg == MPR121_ECR) {
+      if (overCurrent) value = 0;  // 過電流中は計測を開始しない
+      bool run = (value & 0x3F) != 0;
+      regs[reg] = value;
+      if (run && !running) start();
+      if (!run) running = false;
+      return;
+    }
+    regs[reg] = value;
+  }
+
+  uint8_t readRegister(uint8_t reg) {
+    if (reg == MPR121_TOUCHSTATUS_L) return touchStatus & 0xFF;
+    if (reg == MPR121_TOUCHSTATUS_H) return ((touchStatus >> 8) & 0x1F) | (overCurrent ? 0x80 : 0);
+    if (reg == 0x02) return oorMask & 0xFF;
+    if (reg == 0x03) return ((oorMask >> 8) & 0x0F) | (oorMask ? 0x80 : 0);  // bit7：自動キャリブレーション失敗
+    if (reg >= MPR121_FILTDATA_0L && reg < MPR121_BASELINE_0) {
+      uint16_t data = filtered[(reg - MPR121_FILTDATA_0L) / 2];
+      return (reg & 1) ? (data >> 8) : (data & 0xFF);  // 下位バイトが偶数アドレス
+    }
+    if (reg >= MPR121_BASELINE_0 && reg < MPR121_BASELINE_0 + maxPort) {
+      return base[reg - MPR121_BASELINE_0] >> 2;
+    }
+    return regs[reg];
+  }
+};
+
+#endif
@@ -0,0 +1,69 @@
+/**
+ * @file Options
+ * @brief ホストのツールのコマンドライン引数の読み取り
+ * @details 「--名前 値」の組で指定するオプションを順に取り出し、ツールごとの処理に渡す。
+ *          値のない引数が残る場合と、ツールが受け付けない名前の場合は使い方を表示して誤りとする。
+ *
+ * @section 使い方
+ *    bool parsed = parseOptionPairs(argc, argv, [&](const std::string& key, const std::string& value) {
+ *      if (key == "--scenario") options.scenario = split(value);
+ *      else if (key == "--seconds") options.seconds = atof(value.c_str());
+ *      else return false;  // 受け付けない名前
+ *      return true;
+ *    });
+ */
+
+// インクルードガード
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//*****************************************************************************************************************************
+/**
+ * @brief カンマ区切りの文字列を分割する（空の項目は除く）
+ */
+//*****************************************************************************************************************************
+inline std::vector<std::string> split(const std::string& text) {
+  std::vector<std::string> items;
+  size_t start = 0;
+  while (start <= text.size()) {
+    size_t end = text.find(',', start);
+    if (end == std::string::npos) end = text.size();
+    if (end > start) items.push_back(text.substr(start, end - start));
+    start = end + 1;
+  }
+  return items;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 「--名前 値」の組のコマンドライン引数を読み取る
+ * @param argc mainの引数
+ * @param argv mainの引数
+ * @param handler 1組ごとに名前と値を渡す処理（受け付けない名前の場合はfalseを返す）
+ * @return 全ての組を読み取った場合true
+ */
+//*****************************************************************************************************************************
+template <class Handler>
+inline bool parseOptionPairs(int argc, char** argv, Handler handler) {
+  // 値のない引数が残る場合は無視せずに誤りとする
+  if (argc % 2 == 0) {
+    fprintf(stderr, "missing value for option: %s\n", argv[argc - 1]);
+    fprintf(stderr, "usage: %s [--option value]...\n", argv[0]);
+    return false;
+  }
+  for (int n = 1; n + 1 < argc; n += 2) {
+    std::string key = argv[n];
+    if (!handler(key, std::string(argv[n + 1]))) {
+      fprintf(stderr, "unknown option: %s\n", key.c_str());
+      fprintf(stderr, "usage: %s [--option value]...\n", argv[0]);
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif
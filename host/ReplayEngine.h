@@ -0,0 +1,283 @@
+/**
+ * @file ReplayEngine
+ * @brief 記録データの並列再生
+ * @details 複数基板のトレースを 基板 × ポートのグループ のシャードに分割して複数スレッドで再生し、
+ *          各シャードのタッチ／リリースを時刻順の1本のタイムラインにまとめる。
+ *          結果は先頭から1スキャンずつ再生した場合と完全に一致する。
+ *
+ * @section 再生の手順
+ * - 各ポートの判定は他のポートに依存しない（共通の間引きカウンタはスキャン数のみで決まる）ため、
+ *    シャードごとにそのグループのポートのみを使用するMPR121Detectorで先頭スキャンから再生する。
+ *    シャード間で結果を待つことはなく、1基板の長いトレースでも使用ポート数までのスレッドで並列に再生できる
+ * - 1スキャンあたりの処理はポート数によらない部分があるため、グループはシャード数がスレッド数以上となる最小の分割とする
+ *    （基板数がスレッド数以上であれば1基板1シャード）
+ * - 空いたスレッドが未処理のシャードを登録順に取り出して処理する
+ * - 再生中は時間区間（window）の境界ごとにgetPortState()でポートの判定状態（チェックポイント）を記録する。
+ *    チェックポイントは再生後も保持され、replayFrom()でsetPortState()により任意の区間から再生を再開できる
+ */
+
+// インクルードガード
+#ifndef REPLAY_ENGINE_H
+#define REPLAY_ENGINE_H
+
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "MPR121_Config.h"
+#include "Trace.h"
+
+//*****************************************************************************************************************************
+// 再生結果のイベント
+struct ReplayEvent {
+  uint64_t time;   // 時刻[us]
+  uint16_t board;  // トレース（基板）の番号
+  uint8_t port;    // ポート番号
+  bool touched;    // trueでタッチ、falseでリリース
+
+  bool operator==(const ReplayEvent& other) const {
+    return time == other.time && board == other.board && port == other.port && touched == other.touched;
+  }
+  bool operator<(const ReplayEvent& other) const {
+    if (time != other.time) return time < other.time;
+    if (board != other.board) return board < other.board;
+    return port < other.port;
+  }
+};
+
+//*****************************************************************************************************************************
+// 並列再生エンジン
+class ReplayEngine {
+public:
+  // 再生の統計
+  struct Stats {
+    size_t shards = 0;       // シャード数（基板 × ポートのグループ）
+    size_t scans = 0;        // 再生したスキャン数（基板ごと）
+    size_t checkpoints = 0;  // 記録したチェックポイント数（ポートごと）
+    double work = 0;         // 全シャードのCPU時間の合計[s]
+    double longest = 0;      // 最も長いシャードのCPU時間[s]（並列再生の所要時間の下限）
+  };
+
+  /**
+   * @param setThreads スレッド数（0でコア数）
+   * @param setWindow チェックポイントを記録する間隔[スキャン数]
+   */
+  ReplayEngine(unsigned setThreads = 0, size_t setWindow = 20000)
+    : threads(setThreads ? setThreads : std::max(1u, std::thread::hardware_concurrency())),
+      window(std::max<size_t>(setWindow, 2)) {}
+
+  // 再生時に読み込む設定データ（MPR121Manager::saveConfig()形式、空の場合は初期値）
+  void setConfig(const std::vector<uint8_t>& blob) {
+    config = blob;
+  }
+
+  const Stats& getStats() const {
+    return stats;
+  }
+
+  size_t getWindow() const {
+    return window;
+  }
+
+  /**
+   * @brief 直前のrun()で記録した、指定区間の開始時点のポートの判定状態を返す
+   * @param board 基板の番号
+   * @param port ポート番号
+   * @param index 区間の番号（区間indexはスキャン index × window の判定後から始まる。先頭の区間0は記録なし）
+   * @return 判定状態（記録がない場合はnullptr）
+   */
+  const MPR121PortState* getCheckpoint(size_t board, uint8_t port, size_t index) const {
+    const Shard* shard = findShard(board, port);
+    if (shard == nullptr || index == 0 || index > shard->checkpoints[port].size()) return nullptr;
+    return &shard->checkpoints[port][index - 1];
+  }
+
+  /**
+   * @brief 全トレースを並列に再生してイベントを時刻順に返す
+   * @param traces 基板ごとのトレース（番号がReplayEvent::boardになる）
+   */
+  std::vector<ReplayEvent> run(const std::vector<Trace>& traces) {
+    stats = Stats();
+
+    // シャードの作成（基板ごとに、記録したポートをグループ数に分ける）
+    size_t boards = 0;
+    for (const Trace& trace : traces) boards += (trace.size() > 0);
+    size_t groups = boards ? (threads + boards - 1) / boards : 1;
+    shards.clear();
+    for (size_t board = 0; board < traces.size(); board++) {
+      const Trace& trace = traces[board];
+      if (trace.size() == 0) continue;
+      stats.scans += trace.size();
+      uint8_t ports = 0;
+      for (uint8_t port = 0; port < Trace::maxPort; port++) ports += (trace.portMask >> port) & 1;
+      size_t count = std::min<size_t>(groups, ports);
+      uint8_t used = 0;
+      for (uint8_t port = 0; port < Trace::maxPort; port++) {
+        if (!((trace.portMask >> port) & 1)) continue;
+        size_t group = used++ * count / ports;
+        if (shards.empty() || shards.back().board != board || shards.back().group != group) {
+          Shard shard;
+          shard.trace = &trace;
+          shard.board = (uint16_t)board;
+          shard.group = group;
+          shards.push_back(shard);
+        }
+        shards.back().portMask |= (1 << port);
+      }
+    }
+    stats.shards = shards.size();
+
+    // 空いたスレッドが次のシャードを取り出して再生する（シャード間の待ち合わせはない）
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> pool;
+    for (unsigned n = 0; n < threads; n++) {
+      pool.emplace_back([&]() {
+        for (size_t index = next++; index < shards.size(); index = next++) {
+          double startTime = threadTime();
+          replayShard(shards[index]);
+          shards[index].elapsed = threadTime() - startTime;
+        }
+      });
+    }
+    for (std::thread& thread : pool) thread.join();
+
+    // タイムラインをまとめる
+    std::vector<ReplayEvent> events;
+    for (const Shard& shard : shards) {
+      for (const std::vector<MPR121PortState>& checkpoint : shard.checkpoints) stats.checkpoints += checkpoint.size();
+      stats.work += shard.elapsed;
+      stats.longest = std::max(stats.longest, shard.elapsed);
+      events.insert(events.end(), shard.events.begin(), shard.events.end());
+    }
+    std::sort(events.begin(), events.end());
+    return events;
+  }
+
+  /**
+   * @brief 直前のrun()で記録したチェックポイントから、指定ポートの再生を再開する
+   * @param traces run()に与えたトレース
+   * @param board 基板の番号
+   * @param port ポート番号
+   * @param index 再開する区間の番号（getCheckpoint()参照）
+   * @return 区間の開始以降のイベント（チェックポイントがない場合は空）
+   * @details 再開時のタッチ状態は変化として出力しないため、run()の結果のうち同じ範囲のイベントと一致する
+   */
+  std::vector<ReplayEvent> replayFrom(const std::vector<Trace>& traces, size_t board, uint8_t port, size_t index) const {
+    std::vector<ReplayEvent> events;
+    const MPR121PortState* checkpoint = getCheckpoint(board, port, index);
+    if (checkpoint == nullptr || board >= traces.size()) return events;
+
+    const Trace& trace = traces[board];
+    MPR121Detector detector(1 << port);
+    if (!config.empty()) detector.loadConfig(config.data(), config.size());
+    size_t first = index * window;
+    detector.restart(trace.filteredAt(first), trace.baselineAt(first));
+    detector.setPortState(port, *checkpoint);
+    replayRange(detector, trace, (uint16_t)board, first + 1, checkpoint->touched << port, events, nullptr);
+    return events;
+  }
+
+  /**
+   * @brief 全トレースを先頭から1スキャンずつ再生する（比較用）
+   */
+  std::vector<ReplayEvent> runSequential(const std::vector<Trace>& traces) {
+    static TwoWire noBus;
+    HostClock::simulated = true;
+    MPR121Manager manager(0x5A, 0x0FFF, &noBus);
+    if (!config.empty()) manager.loadConfig(config.data(), config.size());
+    std::vector<ReplayEvent> events;
+    for (size_t board = 0; board < traces.size(); board++) {
+      const Trace& trace = traces[board];
+      if (trace.size() == 0) continue;
+      manager.replay(trace.filteredAt(0), trace.baselineAt(0), true);
+      uint16_t lastTouched = 0;
+      for (size_t n = 1; n < trace.size(); n++) {
+        manager.replay(trace.filteredAt(n), trace.baselineAt(n));
+        for (uint8_t port = 0; port < Trace::maxPort; port++) {
+          if (!((trace.portMask >> port) & 1)) continue;
+          bool touched = manager.isTouched(port);
+          if (touched != (bool)((lastTouched >> port) & 1)) {
+            lastTouched ^= (1 << port);
+            events.push_back({ trace.time[n], (uint16_t)board, port, touched });
+          }
+        }
+      }
+    }
+    std::sort(events.begin(), events.end());
+    return events;
+  }
+
+private:
+  // 基板 × ポートのグループ
+  struct Shard {
+    const Trace* trace = nullptr;
+    uint16_t board = 0;
+    size_t group = 0;                                          // 基板内のグループの番号
+    uint16_t portMask = 0;                                     // 再生するポート
+    std::vector<ReplayEvent> events;                           // グループ内のイベント
+    std::vector<MPR121PortState> checkpoints[Trace::maxPort];  // ポートごとの、区間1以降の開始時点の判定状態
+    double elapsed = 0;                                        // CPU時間[s]
+  };
+
+  unsigned threads;  // スレッド数
+  size_t window;     // チェックポイントの間隔[スキャン数]
+  std::vector<uint8_t> config;
+  std::vector<Shard> shards;
+  Stats stats;
+
+  const Shard* findShard(size_t board, uint8_t port) const {
+    for (const Shard& shard : shards) {
+      if (shard.board == board && port < Trace::maxPort && ((shard.portMask >> port) & 1)) return &shard;
+    }
+    return nullptr;
+  }
+
+  // 呼び出したスレッドのCPU時間[s]（1コアで複数スレッドを動かした場合も各シャードの処理量を計る）
+  static double threadTime() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+  }
+
+  /**
+   * @brief グループのポートを先頭から再生してイベントとチェックポイントを記録する
+   * @details 判定処理は起動待機や通信を伴わないため、MPR121Managerではなく判定処理のみを使用する
+   */
+  void replayShard(Shard& shard) {
+    const Trace& trace = *shard.trace;
+    MPR121Detector detector(shard.portMask);
+    if (!config.empty()) detector.loadConfig(config.data(), config.size());
+    detector.restart(trace.filteredAt(0), trace.baselineAt(0));
+    replayRange(detector, trace, shard.board, 1, 0, shard.events, shard.checkpoints);
+  }
+
+  /**
+   * @brief 指定スキャンから末尾まで、判定処理の使用ポートを再生する
+   * @param touched 再生開始時のタッチ状態（ビットマスク）
+   * @param checkpoints ポートごとの、区間の境界での判定状態の記録先（nullptrで記録しない）
+   */
+  void replayRange(MPR121Detector& detector, const Trace& trace, uint16_t board, size_t first, uint16_t touched,
+                   std::vector<ReplayEvent>& events, std::vector<MPR121PortState>* checkpoints) const {
+    uint16_t portMask = detector.getPortMask();
+    for (size_t scan = first; scan < trace.size(); scan++) {
+      detector.detect((uint32_t)trace.time[scan], trace.filteredAt(scan), trace.baselineAt(scan));
+      uint16_t changed = detector.getTouchedPorts() ^ touched;
+      for (uint8_t port = 0; changed != 0 && port < Trace::maxPort; port++) {
+        if (!((changed >> port) & 1)) continue;
+        changed &= ~(1 << port);
+        touched ^= (1 << port);
+        events.push_back({ trace.time[scan], board, port, (bool)((touched >> port) & 1) });
+      }
+      if (checkpoints != nullptr && scan % window == 0) {
+        for (uint8_t port = 0; port < Trace::maxPort; port++) {
+          if (!((portMask >> port) & 1)) continue;
+          checkpoints[port].emplace_back();
+          detector.getPortState(port, checkpoints[port].back());
+        }
+      }
+    }
+  }
+};
+
+#endif
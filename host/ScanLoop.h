@@ -0,0 +1,225 @@
+/**
+ * @file ScanLoop
+ * @brief epollで駆動する更新ループ（Linux用）
+ * @details 更新周期のtimerfd、外部からの起床用のeventfd、MPR121のIRQ端子（gpiochipのGPIO行）を1つのepollにまとめ、
+ *          そのファイルディスクリプタを返す。アプリケーションは自身のepollにgetFd()を登録し、読み出し可能になったら
+ *          dispatch()を呼ぶだけでよく、ネットワーク処理などと同じスレッドでビジーループなしに更新できる。
+ *
+ * @section 更新周期
+ * - アクティブ周期（activePeriod）：タッチ中・判定途中（setBusyがtrue）、またはIRQ／signal()から保持時間（holdTime）以内はこの周期で更新する
+ * - アイドル周期（idlePeriod）：それ以外はこの周期に落とし、ベースラインの追従に必要な分だけ読み出す（0で常にアクティブ周期）
+ *    MPR121のIRQはタッチ状態レジスタを読み出すまで解除されないため、保持時間は状態レジスタの確認間隔
+ *    （statusInterval × activePeriod）より長くすること。IRQを使わない場合は、タッチの確定に必要な連続判定を
+ *    アイドル周期で待つと検出が遅れる（または取りこぼす）ため、setBusyは判定途中のポートでもtrueを返すこと。
+ *    その場合もアイドル周期は、最短のタッチ時間から確定に必要な時間（連続判定回数 × activePeriod）を引いた値より短くすること。
+ */
+
+// インクルードガード
+#ifndef SCAN_LOOP_H
+#define SCAN_LOOP_H
+
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <functional>
+#include <string>
+#include "Arduino.h"
+
+//*****************************************************************************************************************************
+// epoll駆動の更新ループ
+class ScanLoop {
+public:
+  // 起床の統計
+  struct Stats {
+    uint64_t wakeups = 0;     // dispatch()で処理した回数
+    uint64_t scans = 0;       // 更新回数
+    uint64_t activeScans = 0; // アクティブ周期での更新回数
+    uint64_t signals = 0;     // signal()による起床回数
+    uint64_t irqs = 0;        // IRQ端子の立ち下がり回数
+  };
+
+  /**
+   * @brief コンストラクタ
+   * @param setScan 1回の更新処理（MPR121BatchUpdate::update()や各基板のupdate()と配信など）
+   * @param setBusy 更新後に呼ばれ、アクティブ周期を続ける必要がある場合にtrueを返す関数（タッチ中・判定途中など、省略可）
+   */
+  ScanLoop(std::function<void()> setScan, std::function<bool()> setBusy = nullptr)
+    : scan(setScan), busy(setBusy) {}
+  ScanLoop(const ScanLoop&) = delete;
+  ScanLoop& operator=(const ScanLoop&) = delete;
+  ~ScanLoop() {
+    close();
+  }
+
+  /**
+   * @brief タイマー・eventfd・epollを作成して更新を開始する
+   * @param setActivePeriod アクティブ周期[us]
+   * @param setIdlePeriod アイドル周期[us]（0で常にアクティブ周期）
+   * @param setHoldTime IRQ／signal()後にアクティブ周期を続ける時間[us]
+   * @return 作成できた場合true
+   */
+  bool open(uint32_t setActivePeriod, uint32_t setIdlePeriod = 0, uint32_t setHoldTime = 500000) {
+    close();
+    activePeriod = setActivePeriod;
+    idlePeriod = setIdlePeriod;
+    holdTime = setHoldTime;
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || timerFd < 0 || eventFd < 0 || !watch(timerFd) || !watch(eventFd)) {
+      close();
+      return false;
+    }
+    active = true;
+    lastWake = HostClock::micros64();
+    return arm(activePeriod);
+  }
+
+  /**
+   * @brief gpiochipのGPIO行をIRQ端子として登録する（立ち下がりで即時に更新）
+   * @param chip gpiochipのデバイスファイル（/dev/gpiochip0など）
+   * @param line GPIO行の番号
+   * @return 登録できた場合true
+   */
+  bool attachIrq(const std::string& chip, uint32_t line) {
+    int chipFd = ::open(chip.c_str(), O_RDONLY | O_CLOEXEC);
+    if (chipFd < 0) return false;
+    gpio_v2_line_request request = {};
+    request.offsets[0] = line;
+    request.num_lines = 1;
+    request.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    strncpy(request.consumer, "mpr121", sizeof(request.consumer) - 1);
+    bool requested = ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &request) == 0;
+    ::close(chipFd);
+    if (!requested) return false;
+
+    if (irqFd >= 0) ::close(irqFd);
+    irqFd = request.fd;
+    fcntl(irqFd, F_SETFL, fcntl(irqFd, F_GETFL) | O_NONBLOCK);
+    return watch(irqFd);
+  }
+
+  void close() {
+    for (int* fd : { &irqFd, &eventFd, &timerFd, &epollFd }) {
+      if (*fd >= 0) ::close(*fd);
+      *fd = -1;
+    }
+  }
+
+  // アプリケーションのepollに登録するファイルディスクリプタ（EPOLLINで待つ）
+  int getFd() const {
+    return epollFd;
+  }
+
+  const Stats& getStats() const {
+    return stats;
+  }
+
+  /**
+   * @brief 次の周期を待たずに更新する（他のスレッド・シグナルハンドラーからも呼び出せる）
+   * @details IRQ端子を使用できない環境では、IRQの代わり（スタンドイン）としても使用する
+   */
+  void signal() {
+    uint64_t one = 1;
+    ssize_t written = write(eventFd, &one, sizeof(one));
+    (void)written;
+  }
+
+  /**
+   * @brief getFd()が読み出し可能になったときに呼び、必要であれば1回更新する
+   * @return 更新した場合true
+   * @details 同時に複数の要因で起床した場合も更新は1回にまとめる
+   */
+  bool dispatch() {
+    epoll_event events[3];
+    int count = epoll_wait(epollFd, events, 3, 0);
+    bool due = false, woken = false;
+    for (int n = 0; n < count; n++) {
+      int fd = events[n].data.fd;
+      uint64_t value;
+      if (fd == timerFd) {
+        due |= read(timerFd, &value, sizeof(value)) == sizeof(value);
+      } else if (fd == eventFd) {
+        if (read(eventFd, &value, sizeof(value)) == sizeof(value)) {
+          woken = true;
+          stats.signals += value;
+        }
+      } else if (fd == irqFd) {
+        gpio_v2_line_event event;
+        while (read(irqFd, &event, sizeof(event)) == sizeof(event)) {
+          woken = true;
+          stats.irqs++;
+        }
+      }
+    }
+    if (!due && !woken) return false;
+    stats.wakeups++;
+
+    uint64_t now = HostClock::micros64();
+    if (woken) lastWake = now;
+    scan();
+    stats.scans++;
+    if (active) stats.activeScans++;
+
+    // 更新結果と起床からの経過時間で次の周期を決める
+    bool keep = (idlePeriod == 0) || (now - lastWake < holdTime) || (busy && busy());
+    if (keep != active) {
+      active = keep;
+      arm(active ? activePeriod : idlePeriod);
+    }
+    return true;
+  }
+
+  /**
+   * @brief 単独で使用する場合のループ（getFd()のみを待って更新し続ける）
+   * @param duration 実行時間[us]（0で停止しない）
+   */
+  void run(uint64_t duration = 0) {
+    int waitFd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    epoll_ctl(waitFd, EPOLL_CTL_ADD, epollFd, &event);
+    uint64_t start = HostClock::micros64();
+    while (duration == 0 || HostClock::micros64() - start < duration) {
+      if (epoll_wait(waitFd, &event, 1, 100) > 0) dispatch();
+    }
+    ::close(waitFd);
+  }
+
+private:
+  std::function<void()> scan;  // 更新処理
+  std::function<bool()> busy;  // アクティブ周期を続けるか
+  int epollFd = -1;            // まとめたepoll
+  int timerFd = -1;            // 更新周期のタイマー
+  int eventFd = -1;            // signal()用
+  int irqFd = -1;              // IRQ端子のGPIO行
+  uint32_t activePeriod = 0;   // アクティブ周期[us]
+  uint32_t idlePeriod = 0;     // アイドル周期[us]
+  uint32_t holdTime = 0;       // 起床後にアクティブ周期を続ける時間[us]
+  bool active = true;          // アクティブ周期で動作中か
+  uint64_t lastWake = 0;       // 最後にIRQ／signal()で起床した時刻[us]
+  Stats stats;                 // 統計
+
+  bool watch(int fd) {
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+  }
+
+  // タイマーを指定周期で設定する（最初の満了は1周期後）
+  bool arm(uint32_t period) {
+    itimerspec spec = {};
+    spec.it_interval.tv_sec = period / 1000000;
+    spec.it_interval.tv_nsec = (period % 1000000) * 1000L;
+    spec.it_value = spec.it_interval;
+    return timerfd_settime(timerFd, 0, &spec, nullptr) == 0;
+  }
+};
+
+#endif
@@ -0,0 +1,159 @@
+/**
+ * @file Scorer
+ * @brief 合成信号に対する判定結果の採点
+ * @details SignalGeneratorの波形を模擬MPR121に入力してMPR121Managerを一定周期で更新し、
+ *          タッチ状態の変化を正解ラベルと照合して、検出遅延・見逃し・誤検出・チャタリングを集計する。
+ *
+ * @section 照合方法
+ * - タッチの検出は、同じポートのラベルのうち開始時刻以降・終了時刻 + tolerance以前の未検出のものに対応付ける
+ *    対応するラベルがない場合は誤検出、同じラベル内での2回目以降の検出はチャタリングとして数える。
+ * - リリースの検出は直前に検出したラベルに対応付け、ラベル終了時刻からの遅延を記録する
+ */
+
+// インクルードガード
+#ifndef SCORER_H
+#define SCORER_H
+
+#include <algorithm>
+#include <vector>
+#include "MPR121_Config.h"
+#include "SimBus.h"
+#include "SignalGen.h"
+
+//*****************************************************************************************************************************
+// タッチ状態の変化
+struct TouchTransition {
+  uint64_t time;  // 検出時刻[us]
+  uint8_t port;   // ポート番号
+  bool touched;   // trueでタッチ、falseでリリース
+};
+
+//*****************************************************************************************************************************
+// 採点結果
+struct TouchScore {
+  size_t labels = 0;                    // 正解のタッチ数
+  size_t detected = 0;                  // 検出できたタッチ数
+  size_t missed = 0;                    // 見逃したタッチ数
+  size_t falseTouches = 0;              // 誤検出数
+  size_t chatter = 0;                   // チャタリング（同じタッチ内での再検出）数
+  std::vector<uint64_t> touchLatency;   // タッチ検出遅延[us]
+  std::vector<uint64_t> releaseLatency; // リリース検出遅延[us]
+
+  // 百分位数[us]
+  static uint64_t percentile(std::vector<uint64_t> values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)(p / 100.0 * (values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+  }
+};
+
+//*****************************************************************************************************************************
+/**
+ * @brief タッチ状態の変化を正解ラベルと照合して採点する
+ * @param labels 正解ラベル
+ * @param transitions タッチ状態の変化（時刻順）
+ * @param tolerance ラベル終了後もタッチ検出を正解とみなす時間[us]
+ * @param matches 指定した場合、各変化に対応付けたラベルの番号を格納する（誤検出は-1、チャタリングは-2、対応なしのリリースは-1）
+ */
+//*****************************************************************************************************************************
+inline TouchScore scoreTransitions(const std::vector<TouchLabel>& labels, const std::vector<TouchTransition>& transitions,
+                                   uint64_t tolerance = 500000, std::vector<int>* matches = nullptr) {
+  TouchScore score;
+  if (matches != nullptr) matches->assign(transitions.size(), -1);
+  score.labels = labels.size();
+  std::vector<bool> detected(labels.size(), false);
+  int current[12];  // ポートごとの直前に検出したラベル
+  for (int& c : current) c = -1;
+
+  for (size_t t = 0; t < transitions.size(); t++) {
+    const TouchTransition& transition = transitions[t];
+    if (transition.port >= 12) continue;
+    int& active = current[transition.port];
+
+    if (!transition.touched) {
+      // リリース：直前のラベルの終了時刻からの遅延
+      if (active >= 0 && transition.time >= labels[active].end) {
+        score.releaseLatency.push_back(transition.time - labels[active].end);
+        if (matches != nullptr) (*matches)[t] = active;
+      }
+      continue;
+    }
+
+    // タッチ：対応するラベルを探す
+    int match = -1;
+    bool repeated = false;
+    for (size_t n = 0; n < labels.size(); n++) {
+      const TouchLabel& label = labels[n];
+      if (label.port != transition.port) continue;
+      if (transition.time < label.start || transition.time > label.end + tolerance) continue;
+      if (detected[n]) repeated = true;
+      else match = (int)n;
+    }
+
+    if (matches != nullptr) (*matches)[t] = (match >= 0) ? match : (repeated ? -2 : -1);
+    if (match >= 0) {
+      detected[match] = true;
+      active = match;
+      score.detected++;
+      score.touchLatency.push_back(transition.time - labels[match].start);
+    } else if (repeated) {
+      score.chatter++;
+    } else {
+      active = -1;
+      score.falseTouches++;
+    }
+  }
+  score.missed = score.labels - score.detected;
+  return score;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 合成信号を模擬MPR121に入力し、MPR121Managerを一定周期で更新してタッチ状態の変化を記録する
+ * @param generator 入力する合成信号
+ * @param duration 実行時間[us]
+ * @param scanPeriod update()の呼び出し周期[us]
+ * @param portMask 使用ポート
+ * @param configure 起動後のMPR121Managerの設定処理（MPR121Manager&を引数とする関数）
+ */
+//*****************************************************************************************************************************
+template <class Configure>
+std::vector<TouchTransition> runScenario(SignalGenerator& generator, uint64_t duration, uint32_t scanPeriod,
+                                         uint16_t portMask, Configure configure) {
+  HostClock::simulated = true;
+  HostClock::now = 0;
+
+  SimBus bus;
+  TwoWire wire(&bus);
+  MPR121Mock mock;
+  mock.setSource([&generator](uint8_t port, uint64_t time) {
+    return generator(port, time);
+  });
+  bus.attach(&mock);
+
+  MPR121Manager manager(0x5A, portMask, &wire);
+  configure(manager);
+
+  std::vector<TouchTransition> transitions;
+  uint16_t lastTouched = 0;
+  uint64_t next = HostClock::now;
+  while (HostClock::now < duration) {
+    manager.update();
+
+    for (uint8_t port = 0; port < 12; port++) {
+      bool touched = manager.isTouched(port);
+      if (touched != (bool)((lastTouched >> port) & 1)) {
+        lastTouched ^= (1 << port);
+        transitions.push_back({ HostClock::now, port, touched });
+      }
+    }
+
+    // 次の更新時刻まで待機
+    next += scanPeriod;
+    if (HostClock::now < next) HostClock::now = next;
+  }
+  return transitions;
+}
+
+#endif
@@ -0,0 +1,168 @@
+/**
+ * @file SignalGen
+ * @brief 電極の計測値を模擬する合成信号の生成
+ * @details タッチ（ステップ／ゆっくりした接近）、温度ドリフト、電源ハム（50/60Hz）、ノイズ、水膜による同相変化を
+ *          組み合わせた波形を生成し、MPR121Mock::Sourceとして使用する。生成したタッチは正解ラベルとして取得できる。
+ *
+ * @section 正解ラベル
+ * - タッチの深さの50%を下回ってから、50%を上回るまでをタッチ中とする
+ *    ゆっくりした接近では立ち上がりの中間点が開始時刻となる。水膜などタッチ以外の変化はラベルを持たない。
+ *
+ * @section プリセット（preset()）
+ * - step    : 深さ60のステップ状のタッチ
+ * - slow    : 300msかけて深さ60まで近づくタッチ
+ * - shallow : 深さ35（touchMarginぎりぎり）のゆっくりしたタッチ
+ * - drift   : stepに周期60秒・振幅25の温度ドリフトを加えたもの
+ * - hum     : stepに50Hz・振幅6のハムを加えたもの
+ * - water   : タッチなし。全電極が同時に深さ40まで下がる水膜を繰り返す（検出はすべて誤検出）
+ */
+
+// インクルードガード
+#ifndef SIGNAL_GEN_H
+#define SIGNAL_GEN_H
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+
+//*****************************************************************************************************************************
+// 正解ラベル（タッチ区間）
+struct TouchLabel {
+  uint8_t port;    // ポート番号
+  uint64_t start;  // タッチ開始時刻[us]
+  uint64_t end;    // タッチ終了時刻[us]
+};
+
+//*****************************************************************************************************************************
+// 合成信号の生成
+class SignalGenerator {
+public:
+  float base = 700;              // 非タッチ時の計測値
+  float noise = 1.0;             // ノイズの標準偏差
+  float driftAmplitude = 0;      // 温度ドリフトの振幅
+  float driftPeriod = 60;        // 温度ドリフトの周期[s]
+  float humAmplitude = 0;        // ハムの振幅
+  float humFrequency = 50;       // ハムの周波数[Hz]
+
+  SignalGenerator(uint32_t seed = 1)
+    : random(seed) {}
+
+  /**
+   * @brief タッチを追加する
+   * @param port ポート番号
+   * @param start 接近の開始時刻[us]
+   * @param length 深さに達してから離れ始めるまでの時間[us]
+   * @param depth 計測値の下がり幅
+   * @param ramp 接近・離脱にかかる時間[us]（0でステップ）
+   */
+  void addTouch(uint8_t port, uint64_t start, uint64_t length, float depth, uint64_t ramp = 0) {
+    touches.push_back({ port, start, length, depth, ramp });
+    labels.push_back({ port, start + ramp / 2, start + ramp + length + ramp / 2 });
+  }
+
+  /**
+   * @brief 全電極に同時にかかる水膜（同相の低下）を追加する
+   * @param start 開始時刻[us]
+   * @param length 深さに達してから戻り始めるまでの時間[us]
+   * @param depth 計測値の下がり幅
+   * @param ramp 変化にかかる時間[us]
+   */
+  void addWaterFilm(uint64_t start, uint64_t length, float depth, uint64_t ramp) {
+    films.push_back({ 0xFF, start, length, depth, ramp });
+  }
+
+  // 正解ラベル
+  const std::vector<TouchLabel>& getLabels() const {
+    return labels;
+  }
+
+  // 指定電極・時刻の計測値（MPR121Mock::Sourceとして使用）
+  float operator()(uint8_t port, uint64_t time) {
+    double seconds = time / 1000000.0;
+    float value = base;
+    value += driftAmplitude * sin(2 * M_PI * seconds / driftPeriod);
+    value += humAmplitude * sin(2 * M_PI * humFrequency * seconds);
+    if (noise > 0) value += std::normal_distribution<float>(0.0f, noise)(random);
+
+    for (const Shape& touch : touches) {
+      if (touch.port == port) value -= touch.at(time);
+    }
+    for (const Shape& film : films) {
+      value -= film.at(time);
+    }
+    return value;
+  }
+
+  /**
+   * @brief プリセットのシナリオを作成する
+   * @param name プリセット名（step／slow／shallow／drift／hum／water）
+   * @param duration シナリオの長さ[us]
+   * @param portMask タッチを配置するポート
+   * @param seed 乱数の種
+   * @return 作成したシナリオ（nameが不明の場合はタッチなし）
+   */
+  static SignalGenerator preset(const std::string& name, uint64_t duration, uint16_t portMask = 0x0FFF, uint32_t seed = 1) {
+    SignalGenerator generator(seed);
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<uint64_t> gap(300000, 900000);
+
+    float depth = 60;
+    uint64_t ramp = 0;
+    if (name == "slow") ramp = 300000;
+    if (name == "shallow") depth = 35, ramp = 150000;
+    if (name == "drift") generator.driftAmplitude = 25;
+    if (name == "hum") generator.humAmplitude = 6;
+
+    if (name == "water") {
+      // 水膜は2秒ごとに1秒間
+      for (uint64_t time = 500000; time + 1500000 < duration; time += 2000000) {
+        generator.addWaterFilm(time, 1000000, 40, 200000);
+      }
+      return generator;
+    }
+
+    // ポートごとに間隔をあけてタッチを並べる
+    for (uint8_t port = 0; port < 12; port++) {
+      if (!((portMask >> port) & 1)) continue;
+      std::uniform_int_distribution<uint64_t> length(80000, 400000);
+      for (uint64_t time = gap(random); ; time += gap(random)) {
+        uint64_t hold = length(random);
+        if (time + hold + 2 * ramp + 200000 > duration) break;
+        generator.addTouch(port, time, hold, depth, ramp);
+        time += hold + 2 * ramp;
+      }
+    }
+    return generator;
+  }
+
+private:
+  // 台形状の変化
+  struct Shape {
+    uint8_t port;     // ポート番号（水膜は全電極）
+    uint64_t start;   // 開始時刻[us]
+    uint64_t length;  // 深さを維持する時間[us]
+    float depth;      // 深さ
+    uint64_t ramp;    // 変化にかかる時間[us]
+
+    // 指定時刻の下がり幅
+    float at(uint64_t time) const {
+      if (time < start) return 0;
+      uint64_t t = time - start;
+      if (t < ramp) return depth * t / ramp;
+      t -= ramp;
+      if (t < length) return depth;
+      t -= length;
+      if (t < ramp) return depth * (ramp - t) / ramp;
+      return 0;
+    }
+  };
+
+  std::mt19937 random;              // ノイズ用の乱数
+  std::vector<Shape> touches;       // タッチ
+  std::vector<Shape> films;         // 水膜
+  std::vector<TouchLabel> labels;   // 正解ラベル
+};
+
+#endif
@@ -0,0 +1,130 @@
+/**
+ * @file SimBus
+ * @brief PC上で使用するI2Cバスのシミュレーター
+ * @details MPR121Mockを接続し、クロック速度とトランザクションごとの遅延から転送時間を求めて仮想時刻を進める。
+ *          エラー注入（一定確率のNACK）と、基板の抜き差し（setConnected）を模擬できる。
+ *
+ * @section 複数バスの並行転送
+ * - バスごとに時刻カーソルを持ち、バスごとに独立したコントローラーで並行して転送する構成を模擬する
+ * - 巡回ごとに、各バスでenter()で仮想時刻をそのバスの時刻に合わせてから接続した基板を更新し、leave()でバスの時刻を記録する。
+ *    全バスの更新後、仮想時刻を各バスのleave()の最大値に進める（1本のバスのみの場合は従来どおり）
+ *
+ * @section 転送時間
+ * - 1バイト9ビット（ACK含む）、スタート・ストップ・リピートスタートを各1ビットとして計算する
+ *    転送時間[us] = ビット数 × 1000000 / clockHz + latencyUs
+ */
+
+// インクルードガード
+#ifndef SIM_BUS_H
+#define SIM_BUS_H
+
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "MPR121_Mock.h"
+
+//*****************************************************************************************************************************
+// I2Cバスシミュレーター
+class SimBus : public I2CBus {
+public:
+  // 転送の統計
+  struct Stats {
+    uint64_t transactions = 0;  // 転送回数
+    uint64_t bytes = 0;         // 転送バイト数（アドレス含む）
+    uint64_t busyTime = 0;      // 転送に要した時間の合計[us]
+    uint64_t nacks = 0;         // 未接続によるNACK回数
+    uint64_t errors = 0;        // エラー注入による失敗回数
+  };
+
+  SimBus(uint32_t setClockHz = 400000, uint32_t setLatencyUs = 0, double setErrorRate = 0.0, uint32_t seed = 1)
+    : clockHz(setClockHz), latencyUs(setLatencyUs), errorRate(setErrorRate), random(seed) {}
+
+  // 模擬デバイスを接続
+  void attach(MPR121Mock* device) {
+    devices.push_back({ device, true });
+  }
+
+  // 指定アドレスの模擬デバイスの接続状態を切り替える（抜き差しの模擬）
+  void setConnected(uint8_t address, bool connected) {
+    for (Slot& slot : devices) {
+      if (slot.device->getAddress() == address) slot.connected = connected;
+    }
+  }
+
+  void setErrorRate(double rate) {
+    errorRate = rate;
+  }
+
+  const Stats& getStats() const {
+    return stats;
+  }
+
+  /**
+   * @brief このバスの転送を始める（仮想時刻をバスの時刻カーソルに合わせる）
+   * @param start 巡回の開始時刻[us]（カーソルがそれより前の場合は開始時刻から）
+   */
+  void enter(uint64_t start) {
+    cursor = std::max(cursor, start);
+    HostClock::now = cursor;
+  }
+
+  /**
+   * @brief このバスの転送を終える（仮想時刻をバスの時刻カーソルとして記録する）
+   * @return バスの時刻[us]
+   */
+  uint64_t leave() {
+    cursor = HostClock::now;
+    return cursor;
+  }
+
+  uint8_t transfer(uint8_t address, const uint8_t* writeData, size_t writeLength, uint8_t* readData, size_t readLength) override {
+    // 転送時間を計算して仮想時刻を進める
+    uint64_t bits = 2 + (1 + writeLength) * 9;
+    if (readLength > 0) bits += 1 + (1 + readLength) * 9;
+    uint64_t time = bits * 1000000 / clockHz + latencyUs;
+    HostClock::advance(time);
+
+    stats.transactions++;
+    stats.bytes += 1 + writeLength + (readLength > 0 ? 1 + readLength : 0);
+    stats.busyTime += time;
+
+    // 接続されていないアドレスはNACK
+    MPR121Mock* device = find(address);
+    if (device == nullptr) {
+      stats.nacks++;
+      return 2;
+    }
+
+    // エラー注入
+    if (errorRate > 0 && std::uniform_real_distribution<double>(0.0, 1.0)(random) < errorRate) {
+      stats.errors++;
+      return 3;
+    }
+
+    device->access(writeData, writeLength, readData, readLength);
+    return 0;
+  }
+
+private:
+  struct Slot {
+    MPR121Mock* device;  // 模擬デバイス
+    bool connected;      // 接続状態
+  };
+
+  uint32_t clockHz;     // クロック速度[Hz]
+  uint32_t latencyUs;   // トランザクションごとの遅延[us]
+  double errorRate;     // 転送失敗の確率
+  std::mt19937 random;  // エラー注入用の乱数
+  uint64_t cursor = 0;  // バスの時刻カーソル[us]
+  std::vector<Slot> devices;
+  Stats stats;
+
+  MPR121Mock* find(uint8_t address) {
+    for (Slot& slot : devices) {
+      if (slot.connected && slot.device->getAddress() == address) return slot.device;
+    }
+    return nullptr;
+  }
+};
+
+#endif
@@ -0,0 +1,264 @@
+/**
+ * @file SnapshotRing
+ * @brief 共有メモリのリングバッファによるセンサー状態の配信
+ * @details 基板ごとの更新結果（タッチ状態・計測値・タッチ強度）を共有メモリ上のリングバッファに書き込み、
+ *          複数のプロセスが読み出せるようにする。読み出し側は共有メモリを参照するのみで、システムコールは発生しない。
+ *          各レコードは番号（シーケンス）で書き込み中かどうかを判別するため、書き込み側は読み出し側を待たない。
+ *
+ * @section 形式（ホストのメモリ配置のまま）
+ * - ヘッダー（64バイト）："M121SHM\0" バージョン(4) レコード数(4) レコードサイズ(4) 予約(4) 書き込み済みレコード数(8) 予約
+ * - レコード（80バイト）× レコード数：シーケンス(8) 時刻[us](8) 基板番号(1) I2Cアドレス(1) 使用ポート(2) タッチ状態(2)
+ *    フラグ(2) 計測値(2×12) タッチ強度(2×12) 予約(8)
+ *    n番目（0から）に書き込んだレコードは n % レコード数 の位置に置かれ、書き込み中のシーケンスは 2n+1、完了後は 2n+2 となる。
+ *    計測値・タッチ強度は使用ポートの番号順に詰めて格納する（getRawSnapshot／getStrengthSnapshotと同じ）。
+ */
+
+// インクルードガード
+#ifndef SNAPSHOT_RING_H
+#define SNAPSHOT_RING_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include "MPR121_Config.h"
+
+//*****************************************************************************************************************************
+// 1回の更新分のレコード
+struct SnapshotRecord {
+  // フラグ
+  enum Flag : uint16_t {
+    CONNECTED = 0x01,     // 基板が接続されている
+    OVER_CURRENT = 0x02,  // 過電流を検出した
+  };
+
+  std::atomic<uint64_t> sequence;  // シーケンス（書き込み中は奇数）
+  uint64_t time;                   // 更新時刻[us]
+  uint8_t board;                   // 基板番号
+  uint8_t address;                 // I2Cアドレス
+  uint16_t portMask;               // 使用ポート
+  uint16_t touched;                // タッチ中のポート
+  uint16_t flags;                  // フラグ
+  uint16_t raw[12];                // 計測値（使用ポートを詰めて格納）
+  int16_t strength[12];            // タッチ強度（使用ポートを詰めて格納）
+  uint8_t reserved[8];             // 予約
+};
+static_assert(sizeof(SnapshotRecord) == 80, "SnapshotRecord must be 80 bytes");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory needs lock-free 64-bit atomics");
+
+// 共有メモリのヘッダー
+struct SnapshotRingHeader {
+  char magic[8];                    // "M121SHM\0"
+  uint32_t version;                 // 形式バージョン
+  uint32_t capacity;                // レコード数
+  uint32_t recordSize;              // レコードサイズ
+  uint32_t reserved0;               // 予約
+  std::atomic<uint64_t> published;  // 書き込み済みレコード数
+  uint8_t reserved1[32];            // 予約
+};
+static_assert(sizeof(SnapshotRingHeader) == 64, "SnapshotRingHeader must be 64 bytes");
+
+// 読み出したレコード（共有メモリからコピーした値）
+struct Snapshot {
+  uint64_t sequence;     // レコードの番号（0から）
+  uint64_t time;         // 更新時刻[us]
+  uint8_t board;         // 基板番号
+  uint8_t address;       // I2Cアドレス
+  uint16_t portMask;     // 使用ポート
+  uint16_t touched;      // タッチ中のポート
+  uint16_t flags;        // フラグ
+  uint16_t raw[12];      // 計測値（使用ポートを詰めて格納）
+  int16_t strength[12];  // タッチ強度（使用ポートを詰めて格納）
+};
+
+//*****************************************************************************************************************************
+// 共有メモリの割り当て（書き込み側・読み出し側で共通）
+class SnapshotRing {
+public:
+  static const uint32_t version = 1;  // 形式バージョン
+
+  SnapshotRing() {}
+  SnapshotRing(const SnapshotRing&) = delete;
+  SnapshotRing& operator=(const SnapshotRing&) = delete;
+  ~SnapshotRing() {
+    close();
+  }
+
+  /**
+   * @brief 共有メモリを作成する（書き込み側）
+   * @param setName 共有メモリ名（"/mpr121"など、/dev/shm以下に作成される）
+   * @param capacity レコード数（読み出し側の遅れを許容する回数）
+   * @return 作成できた場合true（同じ名前の共有メモリは作り直す）
+   */
+  bool create(const std::string& setName, uint32_t capacity) {
+    close();
+    if (capacity == 0) return false;
+    shm_unlink(setName.c_str());
+    int fd = shm_open(setName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) return false;
+    size = sizeof(SnapshotRingHeader) + (size_t)capacity * sizeof(SnapshotRecord);
+    if (ftruncate(fd, size) != 0 || !map(fd, PROT_READ | PROT_WRITE)) {
+      ::close(fd);
+      shm_unlink(setName.c_str());
+      return false;
+    }
+    ::close(fd);
+    name = setName;
+    owner = true;
+
+    // ftruncateで0に初期化済みのため、ヘッダーのみ設定して最後にマジックを書く
+    header->version = version;
+    header->capacity = capacity;
+    header->recordSize = sizeof(SnapshotRecord);
+    header->published.store(0, std::memory_order_relaxed);
+    memcpy(header->magic, "M121SHM", 8);
+    std::atomic_thread_fence(std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief 既存の共有メモリを開く（読み出し側）
+   * @return 形式が一致する場合true
+   */
+  bool open(const std::string& setName) {
+    close();
+    int fd = shm_open(setName.c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(SnapshotRingHeader)) {
+      ::close(fd);
+      return false;
+    }
+    size = info.st_size;
+    bool mapped = map(fd, PROT_READ);
+    ::close(fd);
+    if (!mapped) return false;
+
+    if (memcmp(header->magic, "M121SHM", 8) != 0 || header->version != version
+        || header->recordSize != sizeof(SnapshotRecord)
+        || sizeof(SnapshotRingHeader) + (size_t)header->capacity * sizeof(SnapshotRecord) > size) {
+      close();
+      return false;
+    }
+    name = setName;
+    return true;
+  }
+
+  // 割り当てを解除する（作成した側は共有メモリを削除する）
+  void close() {
+    if (header != nullptr) munmap((void*)header, size);
+    if (owner) shm_unlink(name.c_str());
+    header = nullptr;
+    records = nullptr;
+    size = 0;
+    owner = false;
+  }
+
+  bool isOpen() const {
+    return header != nullptr;
+  }
+
+  uint32_t getCapacity() const {
+    return header->capacity;
+  }
+
+protected:
+  SnapshotRingHeader* header = nullptr;  // ヘッダー（共有メモリの先頭）
+  SnapshotRecord* records = nullptr;     // レコードの先頭
+  size_t size = 0;                       // 共有メモリのサイズ
+  std::string name;                      // 共有メモリ名
+  bool owner = false;                    // 作成した側か
+
+  bool map(int fd, int protection) {
+    void* mapped = mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) return false;
+    header = (SnapshotRingHeader*)mapped;
+    records = (SnapshotRecord*)((uint8_t*)mapped + sizeof(SnapshotRingHeader));
+    return true;
+  }
+};
+
+//*****************************************************************************************************************************
+// 書き込み側
+class SnapshotPublisher : public SnapshotRing {
+public:
+  /**
+   * @brief 基板の更新結果をレコードとして書き込む
+   * @param time 更新時刻[us]
+   * @param board 基板番号
+   * @param address I2Cアドレス
+   * @param manager 更新済みのマネージャー（取得時にI2C通信は発生しない）
+   */
+  void publish(uint64_t time, uint8_t board, uint8_t address, MPR121Manager& manager) {
+    uint64_t n = header->published.load(std::memory_order_relaxed);
+    SnapshotRecord& record = records[n % header->capacity];
+
+    // 書き込み中であることを示してから内容を更新する
+    record.sequence.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    record.time = time;
+    record.board = board;
+    record.address = address;
+    record.portMask = manager.getPortMask();
+    record.touched = manager.getTouchedPorts();
+    record.flags = (manager.isConnected() ? SnapshotRecord::CONNECTED : 0)
+                   | (manager.isOverCurrent() ? SnapshotRecord::OVER_CURRENT : 0);
+    manager.getRawSnapshot(record.raw);
+    manager.getStrengthSnapshot(record.strength);
+    record.sequence.store(2 * n + 2, std::memory_order_release);
+    header->published.store(n + 1, std::memory_order_release);
+  }
+};
+
+//*****************************************************************************************************************************
+// 読み出し側
+class SnapshotReader : public SnapshotRing {
+public:
+  // 書き込み済みのレコード数
+  uint64_t getPublished() const {
+    return header->published.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief n番目のレコードを読み出す
+   * @return 読み出せた場合true（まだ書き込まれていない、または読み出し中に上書きされた場合はfalse）
+   */
+  bool read(uint64_t n, Snapshot& snapshot) const {
+    const SnapshotRecord& record = records[n % header->capacity];
+    uint64_t expected = 2 * n + 2;
+    if (record.sequence.load(std::memory_order_acquire) != expected) return false;
+
+    snapshot.sequence = n;
+    snapshot.time = record.time;
+    snapshot.board = record.board;
+    snapshot.address = record.address;
+    snapshot.portMask = record.portMask;
+    snapshot.touched = record.touched;
+    snapshot.flags = record.flags;
+    memcpy(snapshot.raw, record.raw, sizeof(snapshot.raw));
+    memcpy(snapshot.strength, record.strength, sizeof(snapshot.strength));
+
+    // 読み出し中に書き込みが始まっていなければ有効
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return record.sequence.load(std::memory_order_relaxed) == expected;
+  }
+
+  /**
+   * @brief 前回の続きから読み出す
+   * @param cursor 次に読み出すレコードの番号（読み出すたびに進む。遅れてレコードが上書きされた場合は読み飛ばす）
+   * @return 読み出せた場合true（新しいレコードがない場合はfalse）
+   */
+  bool next(uint64_t& cursor, Snapshot& snapshot) const {
+    uint64_t published = getPublished();
+    while (cursor < published) {
+      // リングを1周以上遅れた分は上書きされているため、残っている最古のレコードから読む
+      if (published - cursor > header->capacity) cursor = published - header->capacity;
+      if (read(cursor++, snapshot)) return true;
+    }
+    return false;
+  }
+};
+
+#endif
@@ -0,0 +1,284 @@
+/**
+ * @file Timeline
+ * @brief タッチイベントのタイムラインと遅延の集計
+ * @details 記録または再生で得たタッチイベント（MPR121Event）を時刻順に並べ、正解ラベルとの対応付けから
+ *          ポートごとのタッチ／リリース検出遅延の分布、チャタリング、押しっぱなし（スタック）の時間を集計する。
+ *          結果はCSV（イベント単位）とJSON（ポート単位の集計）で出力する。
+ *
+ * @section 集計項目
+ * - touchLatency / releaseLatency：正解ラベルの開始／終了からTOUCH／RELEASEまでの時間（ラベルがない場合は空）
+ * - chatter：1つのラベルの中での2回目以降のTOUCH（ラベルがない場合は0）
+ * - short：shortTime未満で終わったタッチの回数（ラベルなしでもチャタリングの目安になる）
+ * - stuck：stuckTime以上続いたタッチの回数と時間（記録の終了時点でタッチ中のものは終了時刻までの時間）
+ */
+
+// インクルードガード
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Scorer.h"
+
+//*****************************************************************************************************************************
+// タイムライン上のイベント
+struct TimelineEvent {
+  uint64_t time;          // 発生時刻[us]
+  uint8_t port;           // ポート番号
+  uint8_t type;           // MPR121Event::Type
+  uint8_t velocity;       // ベロシティ
+  int label = -1;         // 対応する正解ラベル（なしは-1、チャタリングは-2）
+  int64_t latency = -1;   // ラベルからの遅延[us]（対応なしは-1）
+  int64_t duration = -1;  // TOUCHからRELEASEまでの時間[us]（RELEASE以外は-1）
+};
+
+// 遅延などの分布
+struct Distribution {
+  std::vector<uint64_t> values;  // 値[us]
+
+  void add(uint64_t value) {
+    values.push_back(value);
+  }
+  void merge(const Distribution& other) {
+    values.insert(values.end(), other.values.begin(), other.values.end());
+  }
+
+  // JSONの値として出力（件数・百分位数・最大値[ms]と、binMs刻みのヒストグラム）
+  std::string json(double binMs = 5) const {
+    std::string text;
+    char buffer[160];
+    uint64_t max = values.empty() ? 0 : *std::max_element(values.begin(), values.end());
+    snprintf(buffer, sizeof(buffer), "{\"count\": %zu, \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f, \"histogram\": [",
+             values.size(), TouchScore::percentile(values, 50) / 1000.0, TouchScore::percentile(values, 90) / 1000.0,
+             TouchScore::percentile(values, 99) / 1000.0, max / 1000.0);
+    text = buffer;
+
+    std::vector<size_t> bins;
+    for (uint64_t value : values) {
+      size_t bin = (size_t)(value / 1000.0 / binMs);
+      if (bin >= bins.size()) bins.resize(bin + 1, 0);
+      bins[bin]++;
+    }
+    bool first = true;
+    for (size_t bin = 0; bin < bins.size(); bin++) {
+      if (bins[bin] == 0) continue;
+      snprintf(buffer, sizeof(buffer), "%s{\"ms\": %.0f, \"count\": %zu}", first ? "" : ", ", bin * binMs, bins[bin]);
+      text += buffer;
+      first = false;
+    }
+    return text + "]}";
+  }
+};
+
+// ポートごとの集計
+struct PortSummary {
+  size_t labels = 0;           // 正解のタッチ数
+  size_t touches = 0;          // TOUCH数
+  size_t releases = 0;         // RELEASE数
+  size_t begins = 0;           // TOUCH_BEGIN数
+  size_t cancels = 0;          // TOUCH_CANCEL数
+  size_t missed = 0;           // 見逃し
+  size_t falseTouches = 0;     // 誤検出
+  size_t chatter = 0;          // 同じラベル内での再検出
+  size_t shortTouches = 0;     // shortTime未満のタッチ
+  size_t stuck = 0;            // stuckTime以上のタッチ
+  Distribution touchLatency;   // タッチ検出遅延
+  Distribution releaseLatency; // リリース検出遅延
+  Distribution duration;       // タッチの継続時間
+  Distribution stuckDuration;  // スタックしたタッチの継続時間
+
+  void merge(const PortSummary& other) {
+    labels += other.labels;
+    touches += other.touches;
+    releases += other.releases;
+    begins += other.begins;
+    cancels += other.cancels;
+    missed += other.missed;
+    falseTouches += other.falseTouches;
+    chatter += other.chatter;
+    shortTouches += other.shortTouches;
+    stuck += other.stuck;
+    touchLatency.merge(other.touchLatency);
+    releaseLatency.merge(other.releaseLatency);
+    duration.merge(other.duration);
+    stuckDuration.merge(other.stuckDuration);
+  }
+};
+
+//*****************************************************************************************************************************
+// タイムライン
+class Timeline {
+public:
+  uint64_t shortTime = 30000;    // これより短いタッチをshortとして数える[us]
+  uint64_t stuckTime = 5000000;  // これ以上続くタッチをstuckとして数える[us]
+  uint64_t tolerance = 500000;   // ラベル終了後もタッチ検出を正解とみなす時間[us]
+
+  // イベントを追加（時刻順でなくてもよい）
+  void add(uint64_t time, uint8_t port, uint8_t type, uint8_t velocity = 0) {
+    TimelineEvent event;
+    event.time = time;
+    event.port = port;
+    event.type = type;
+    event.velocity = velocity;
+    events.push_back(event);
+  }
+
+  const std::vector<TimelineEvent>& getEvents() const {
+    return events;
+  }
+  const PortSummary& getPort(uint8_t port) const {
+    return ports[port];
+  }
+  const PortSummary& getTotal() const {
+    return total;
+  }
+
+  /**
+   * @brief 正解ラベルと照合して集計する
+   * @param labels 正解ラベル
+   * @param endTime 記録の終了時刻[us]（終了時点でタッチ中のものの継続時間に使用）
+   */
+  void analyse(const std::vector<TouchLabel>& labels, uint64_t endTime) {
+    analyse(&labels, endTime);
+  }
+
+  /**
+   * @brief 正解ラベルなしで集計する（遅延・見逃し・誤検出・チャタリングは集計しない）
+   */
+  void analyse(uint64_t endTime) {
+    analyse(nullptr, endTime);
+  }
+
+  /**
+   * @brief イベント単位のCSVを書き出す
+   */
+  bool writeCsv(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) return false;
+    static const char* typeName[] = { "touch", "release", "touch_begin", "touch_cancel" };
+    fprintf(file, "time_us,port,type,velocity,label,latency_us,duration_us\n");
+    for (const TimelineEvent& event : events) {
+      fprintf(file, "%llu,%u,%s,%u,%d,%lld,%lld\n", (unsigned long long)event.time, event.port,
+              event.type < 4 ? typeName[event.type] : "unknown", event.velocity, event.label, (long long)event.latency,
+              (long long)event.duration);
+    }
+    return fclose(file) == 0;
+  }
+
+  /**
+   * @brief ポート単位と全体の集計をJSONで書き出す
+   */
+  bool writeJson(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) return false;
+    fprintf(file, "{\n  \"shortMs\": %.1f, \"stuckMs\": %.1f,\n  \"ports\": [\n", shortTime / 1000.0, stuckTime / 1000.0);
+    bool first = true;
+    for (uint8_t port = 0; port < 12; port++) {
+      const PortSummary& summary = ports[port];
+      if (summary.labels == 0 && summary.touches == 0) continue;
+      fprintf(file, "%s    {\"port\": %u, %s}", first ? "" : ",\n", port, json(summary).c_str());
+      first = false;
+    }
+    fprintf(file, "\n  ],\n  \"total\": {%s}\n}\n", json(total).c_str());
+    return fclose(file) == 0;
+  }
+
+private:
+  std::vector<TimelineEvent> events;  // イベント
+  PortSummary ports[12];              // ポートごとの集計
+  PortSummary total;                  // 全体の集計
+
+  // 集計（labelsがnullptrの場合はラベルとの照合を行わない）
+  void analyse(const std::vector<TouchLabel>* labels, uint64_t endTime) {
+    std::stable_sort(events.begin(), events.end(), [](const TimelineEvent& a, const TimelineEvent& b) {
+      return a.time < b.time;
+    });
+    total = PortSummary();
+
+    for (uint8_t port = 0; port < 12; port++) {
+      PortSummary& summary = ports[port];
+      summary = PortSummary();
+
+      // このポートのTOUCH／RELEASEを正解ラベルと照合
+      std::vector<TouchLabel> portLabels;
+      if (labels != nullptr) {
+        for (const TouchLabel& label : *labels) {
+          if (label.port == port) portLabels.push_back(label);
+        }
+      }
+      std::vector<TouchTransition> transitions;
+      std::vector<size_t> eventIndex;
+      for (size_t n = 0; n < events.size(); n++) {
+        const TimelineEvent& event = events[n];
+        if (event.port != port) continue;
+        if (event.type == MPR121Event::TOUCH_BEGIN) summary.begins++;
+        if (event.type == MPR121Event::TOUCH_CANCEL) summary.cancels++;
+        if (event.type != MPR121Event::TOUCH && event.type != MPR121Event::RELEASE) continue;
+        transitions.push_back({ event.time, port, event.type == MPR121Event::TOUCH });
+        eventIndex.push_back(n);
+      }
+      if (transitions.empty() && portLabels.empty()) continue;
+
+      std::vector<int> matches(transitions.size(), -1);
+      if (labels != nullptr) {
+        TouchScore score = scoreTransitions(portLabels, transitions, tolerance, &matches);
+        summary.labels = score.labels;
+        summary.missed = score.missed;
+        summary.falseTouches = score.falseTouches;
+        summary.chatter = score.chatter;
+        for (uint64_t latency : score.touchLatency) summary.touchLatency.add(latency);
+        for (uint64_t latency : score.releaseLatency) summary.releaseLatency.add(latency);
+      }
+
+      // イベントごとの遅延と継続時間
+      int64_t touchTime = -1;
+      for (size_t t = 0; t < transitions.size(); t++) {
+        TimelineEvent& event = events[eventIndex[t]];
+        event.label = matches[t];
+        if (matches[t] >= 0) {
+          const TouchLabel& label = portLabels[matches[t]];
+          event.latency = transitions[t].touched ? event.time - label.start : event.time - label.end;
+        }
+        if (transitions[t].touched) {
+          summary.touches++;
+          touchTime = event.time;
+        } else {
+          summary.releases++;
+          if (touchTime >= 0) {
+            event.duration = event.time - touchTime;
+            addDuration(summary, event.duration);
+          }
+          touchTime = -1;
+        }
+      }
+      if (touchTime >= 0 && endTime > (uint64_t)touchTime) addDuration(summary, endTime - touchTime);
+
+      total.merge(summary);
+    }
+  }
+
+  void addDuration(PortSummary& summary, uint64_t duration) {
+    summary.duration.add(duration);
+    if (duration < shortTime) summary.shortTouches++;
+    if (duration >= stuckTime) {
+      summary.stuck++;
+      summary.stuckDuration.add(duration);
+    }
+  }
+
+  static std::string json(const PortSummary& summary) {
+    char buffer[320];
+    snprintf(buffer, sizeof(buffer),
+             "\"labels\": %zu, \"touches\": %zu, \"releases\": %zu, \"touchBegins\": %zu, \"touchCancels\": %zu, "
+             "\"missed\": %zu, \"falseTouches\": %zu, \"chatter\": %zu, \"short\": %zu, \"stuck\": %zu",
+             summary.labels, summary.touches, summary.releases, summary.begins, summary.cancels, summary.missed,
+             summary.falseTouches, summary.chatter, summary.shortTouches, summary.stuck);
+    return std::string(buffer) + ", \"touchLatency\": " + summary.touchLatency.json() + ", \"releaseLatency\": "
+           + summary.releaseLatency.json() + ", \"duration\": " + summary.duration.json(50)
+           + ", \"stuckDuration\": " + summary.stuckDuration.json(1000);
+  }
+};
+
+#endif
@@ -0,0 +1,158 @@
+/**
+ * @file Trace
+ * @brief 正解ラベル付きの計測値記録（トレース）
+ * @details 1回の計測（スキャン）ごとに時刻・正解のタッチ状態・各ポートの計測値を保持し、
+ *          MPR121Manager::replay()でI2C通信なしに再生できる形で格納する。
+ *
+ * @section CSV形式（loadTraceCsv）
+ * - 1行1スキャン：時刻[us], 正解のタッチ状態（ビットマスク、10進または0x付き16進）, 計測値0, …, 計測値11[, ベースライン0, …, ベースライン11]
+ *    '#'で始まる行と空行は無視する。ベースラインを省略した場合はベースライン判定では使用できない。
+ */
+
+// インクルードガード
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "SignalGen.h"
+
+//*****************************************************************************************************************************
+// トレース
+struct Trace {
+  static const uint8_t maxPort = 12;  // 1スキャンあたりのポート数
+
+  std::string name;                // トレース名（ファイル名など）
+  uint16_t portMask = 0x0FFF;      // 記録したポート
+  std::vector<uint64_t> time;      // スキャン時刻[us]
+  std::vector<uint16_t> touch;     // 正解のタッチ状態
+  std::vector<uint16_t> filtered;  // 計測値（スキャン数 × maxPort）
+  std::vector<uint16_t> baseline;  // ベースライン値（スキャン数 × maxPort、空の場合は未記録）
+  std::vector<TouchLabel> labels;  // 正解ラベル
+
+  size_t size() const {
+    return time.size();
+  }
+
+  const uint16_t* filteredAt(size_t scan) const {
+    return &filtered[scan * maxPort];
+  }
+
+  const uint16_t* baselineAt(size_t scan) const {
+    return baseline.empty() ? nullptr : &baseline[scan * maxPort];
+  }
+
+  // 記録時間[us]
+  uint64_t duration() const {
+    return time.empty() ? 0 : time.back() - time.front();
+  }
+
+  // 正解のタッチ状態の変化から正解ラベルを作成
+  void buildLabels() {
+    labels.clear();
+    uint64_t start[maxPort] = {};
+    uint16_t last = 0;
+    for (size_t n = 0; n < size(); n++) {
+      uint16_t changed = touch[n] ^ last;
+      for (uint8_t port = 0; port < maxPort; port++) {
+        if (!((changed >> port) & 1)) continue;
+        if ((touch[n] >> port) & 1) start[port] = time[n];
+        else labels.push_back({ port, start[port], time[n] });
+      }
+      last = touch[n];
+    }
+    for (uint8_t port = 0; port < maxPort; port++) {
+      if ((last >> port) & 1) labels.push_back({ port, start[port], time.back() });
+    }
+  }
+};
+
+//*****************************************************************************************************************************
+/**
+ * @brief CSV形式のトレースを読み込む
+ * @param path ファイルパス
+ * @param trace 読み込み先
+ * @return 読み込みに成功した場合true
+ */
+//*****************************************************************************************************************************
+inline bool loadTraceCsv(const std::string& path, Trace& trace) {
+  FILE* file = fopen(path.c_str(), "r");
+  if (file == nullptr) return false;
+
+  trace = Trace();
+  trace.name = path;
+  char line[1024];
+  bool valid = true;
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') continue;
+
+    // カンマ区切りの数値を読み取る
+    uint64_t fields[2 + 2 * Trace::maxPort];
+    size_t count = 0;
+    char* p = line;
+    while (count < 2 + 2 * Trace::maxPort) {
+      char* end;
+      fields[count] = strtoull(p, &end, 0);
+      if (end == p) break;
+      count++;
+      p = end;
+      while (*p == ' ' || *p == '\t') p++;
+      if (*p != ',') break;
+      p++;
+    }
+    if (count != 2 + Trace::maxPort && count != 2 + 2 * Trace::maxPort) {
+      valid = false;
+      break;
+    }
+
+    trace.time.push_back(fields[0]);
+    trace.touch.push_back((uint16_t)fields[1]);
+    for (uint8_t port = 0; port < Trace::maxPort; port++) trace.filtered.push_back((uint16_t)fields[2 + port]);
+    if (count == 2 + 2 * Trace::maxPort) {
+      for (uint8_t port = 0; port < Trace::maxPort; port++) trace.baseline.push_back((uint16_t)fields[2 + Trace::maxPort + port]);
+    }
+  }
+  fclose(file);
+
+  // ベースラインが一部の行にしかない場合は使用しない
+  if (trace.baseline.size() != trace.filtered.size()) trace.baseline.clear();
+  if (!valid || trace.size() == 0) return false;
+  trace.buildLabels();
+  return true;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 合成信号を一定周期でサンプリングしてトレースを作成する
+ * @param generator 合成信号
+ * @param duration 記録時間[us]
+ * @param scanPeriod スキャン周期[us]
+ * @param portMask 記録するポート
+ * @details 計測値はチップの出力と同じく0～1023に丸める。ベースラインは記録しない。
+ */
+//*****************************************************************************************************************************
+inline Trace traceFromGenerator(SignalGenerator& generator, uint64_t duration, uint32_t scanPeriod, uint16_t portMask = 0x0FFF) {
+  Trace trace;
+  trace.portMask = portMask;
+  for (uint64_t time = 0; time < duration; time += scanPeriod) {
+    trace.time.push_back(time);
+    trace.touch.push_back(0);
+    for (uint8_t port = 0; port < Trace::maxPort; port++) {
+      float value = generator(port, time);
+      trace.filtered.push_back((uint16_t)constrain(value + 0.5f, 0.0f, 1023.0f));
+    }
+  }
+
+  // 正解のタッチ状態はラベルから作成
+  trace.labels = generator.getLabels();
+  for (const TouchLabel& label : trace.labels) {
+    for (size_t n = label.start / scanPeriod; n < trace.size() && trace.time[n] < label.end; n++) {
+      if (trace.time[n] >= label.start) trace.touch[n] |= (1 << label.port);
+    }
+  }
+  return trace;
+}
+
+#endif
@@ -0,0 +1,196 @@
+/**
+ * @file TraceFile
+ * @brief 固定長レコードのトレースファイル（メモリマップによるゼロコピー読み出し）
+ * @details 1スキャン1レコード（64バイト固定）のバイナリファイルをメモリマップし、レコードへのポインタを
+ *          そのままイテレータとして返す。解析や変換を行わないため、再生速度はupdate()の処理時間で決まる。
+ *          レコードはMPR121Manager::replay()に直接渡すか、traceSource()でMPR121Mockの計測値として使用する。
+ *
+ * @section 形式（リトルエンディアン、ホストのメモリ配置のまま）
+ * - ヘッダー（64バイト）："M121TRC\0" バージョン(4) 使用ポート(2) フラグ(2) レコード数(8) 予約
+ *    フラグのbit0：ベースラインを記録している
+ * - レコード（64バイト）：時刻[us](8) 正解のタッチ状態(2) 予約(2) 計測値(2×12) ベースライン(2×12) 予約(4)
+ */
+
+// インクルードガード
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include "MPR121_Mock.h"
+#include "Trace.h"
+
+//*****************************************************************************************************************************
+// 1スキャン分のレコード
+struct TraceRecord {
+  uint64_t time;          // 時刻[us]
+  uint16_t touch;         // 正解のタッチ状態
+  uint16_t reserved0;     // 予約
+  uint16_t filtered[12];  // 計測値
+  uint16_t baseline[12];  // ベースライン値（未記録の場合は0）
+  uint32_t reserved1;     // 予約
+};
+static_assert(sizeof(TraceRecord) == 64, "TraceRecord must be 64 bytes");
+
+// ファイルヘッダー
+struct TraceFileHeader {
+  char magic[8];          // "M121TRC\0"
+  uint32_t version;       // 形式バージョン
+  uint16_t portMask;      // 使用ポート
+  uint16_t flags;         // bit0：ベースラインあり
+  uint64_t count;         // レコード数
+  uint8_t reserved[40];   // 予約
+};
+static_assert(sizeof(TraceFileHeader) == 64, "TraceFileHeader must be 64 bytes");
+
+//*****************************************************************************************************************************
+// トレースファイルの読み出し
+class TraceFile {
+public:
+  static const uint32_t version = 1;      // 形式バージョン
+  static const uint16_t hasBaseline = 1;  // フラグ：ベースラインあり
+
+  TraceFile() {}
+  TraceFile(const TraceFile&) = delete;
+  TraceFile& operator=(const TraceFile&) = delete;
+  ~TraceFile() {
+    close();
+  }
+
+  /**
+   * @brief ファイルを開いてメモリマップする
+   * @return トレースファイルとして読み出せる場合true
+   */
+  bool open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(TraceFileHeader)) {
+      ::close(fd);
+      return false;
+    }
+    size = info.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+      size = 0;
+      return false;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    base = (const uint8_t*)mapped;
+
+    // 途中で書き込みが止まったファイルは完全なレコードのみ使用する
+    const TraceFileHeader* header = (const TraceFileHeader*)base;
+    if (memcmp(header->magic, "M121TRC", 8) != 0 || header->version != version) {
+      close();
+      return false;
+    }
+    portMask = header->portMask;
+    flags = header->flags;
+    count = std::min<uint64_t>(header->count, (size - sizeof(TraceFileHeader)) / sizeof(TraceRecord));
+    records = (const TraceRecord*)(base + sizeof(TraceFileHeader));
+    return true;
+  }
+
+  void close() {
+    if (base != nullptr) munmap((void*)base, size);
+    base = nullptr;
+    records = nullptr;
+    size = 0;
+    count = 0;
+  }
+
+  uint16_t getPortMask() const {
+    return portMask;
+  }
+
+  bool getHasBaseline() const {
+    return flags & hasBaseline;
+  }
+
+  size_t getCount() const {
+    return count;
+  }
+
+  // レコードの先頭・末尾（メモリマップ上のポインタ）
+  const TraceRecord* begin() const {
+    return records;
+  }
+  const TraceRecord* end() const {
+    return records + count;
+  }
+  const TraceRecord& operator[](size_t n) const {
+    return records[n];
+  }
+
+  // 指定時刻以降の最初のレコード
+  const TraceRecord* find(uint64_t time) const {
+    return std::lower_bound(begin(), end(), time, [](const TraceRecord& record, uint64_t t) {
+      return record.time < t;
+    });
+  }
+
+private:
+  const uint8_t* base = nullptr;        // メモリマップの先頭
+  size_t size = 0;                      // ファイルサイズ
+  const TraceRecord* records = nullptr; // レコードの先頭
+  size_t count = 0;                     // レコード数
+  uint16_t portMask = 0;                // 使用ポート
+  uint16_t flags = 0;                   // フラグ
+};
+
+//*****************************************************************************************************************************
+/**
+ * @brief トレースをトレースファイルに書き込む
+ * @return 書き込みに成功した場合true
+ */
+//*****************************************************************************************************************************
+inline bool writeTraceFile(const std::string& path, const Trace& trace) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == nullptr) return false;
+
+  TraceFileHeader header = {};
+  memcpy(header.magic, "M121TRC", 8);
+  header.version = TraceFile::version;
+  header.portMask = trace.portMask;
+  header.flags = trace.baseline.empty() ? 0 : TraceFile::hasBaseline;
+  header.count = trace.size();
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+  for (size_t n = 0; ok && n < trace.size(); n++) {
+    TraceRecord record = {};
+    record.time = trace.time[n];
+    record.touch = trace.touch[n];
+    memcpy(record.filtered, trace.filteredAt(n), sizeof(record.filtered));
+    if (trace.baselineAt(n) != nullptr) memcpy(record.baseline, trace.baselineAt(n), sizeof(record.baseline));
+    ok = fwrite(&record, sizeof(record), 1, file) == 1;
+  }
+  return (fclose(file) == 0) && ok;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief トレースファイルの計測値を返すMPR121Mock::Sourceを作成する
+ * @param file 再生するトレースファイル（Sourceを使用する間は開いたままにすること）
+ * @param offset トレースの時刻に加える時間[us]（模擬MPR121の起動後に再生を始める場合など）
+ * @details 各時刻で直近のレコードの値を返す。時刻は単調に進むため、前回の位置から先へ探すのみでコピーは行わない
+ */
+//*****************************************************************************************************************************
+inline MPR121Mock::Source traceSource(const TraceFile& file, uint64_t offset = 0) {
+  auto cursor = std::make_shared<const TraceRecord*>(file.begin());
+  const TraceRecord* end = file.end();
+  return [cursor, end, offset](uint8_t electrode, uint64_t time) -> float {
+    const TraceRecord*& current = *cursor;
+    if (current == end) return 0;
+    while (current + 1 < end && current[1].time + offset <= time) current++;
+    return current->filtered[electrode];
+  };
+}
+
+#endif
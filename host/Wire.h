@@ -0,0 +1,110 @@
+/**
+ * @file Wire.h（ホスト用）
+ * @brief PC上で使用するArduino互換のI2Cクラス
+ * @details 実際の転送はI2CBusを継承したクラス（シミュレーター、Linuxのi2c-devなど）に任せる。
+ *          endTransmission(false)で送信したデータは保留し、続くrequestFrom()と合わせて1回の転送（リピートスタート）で実行する。
+ */
+
+// インクルードガード
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include "Arduino.h"
+
+//*****************************************************************************************************************************
+// I2Cバス（転送処理の基底クラス）
+class I2CBus {
+public:
+  virtual ~I2CBus() {}
+
+  /**
+   * @brief 書き込みと読み出しを1回の転送で行う
+   * @param address スレーブアドレス
+   * @param writeData 書き込むデータ（writeLengthが0の場合は未使用）
+   * @param writeLength 書き込むバイト数
+   * @param readData 読み出し先（readLengthが0の場合は未使用）
+   * @param readLength 読み出すバイト数（0で書き込みのみ）
+   * @return 0:成功、2:アドレスでNACK、3:データでNACK、4:その他のエラー（Wire.endTransmission()と同じ）
+   */
+  virtual uint8_t transfer(uint8_t address, const uint8_t* writeData, size_t writeLength, uint8_t* readData, size_t readLength) = 0;
+};
+
+//*****************************************************************************************************************************
+// Arduino互換のI2Cクラス
+class TwoWire {
+public:
+  static const size_t bufferLength = 128;  // 送受信バッファのサイズ
+
+  TwoWire(I2CBus* setBus = nullptr)
+    : bus(setBus) {}
+
+  void setBus(I2CBus* setBus) {
+    bus = setBus;
+  }
+  void begin() {}
+  void setClock(uint32_t) {}
+
+  void beginTransmission(uint8_t address) {
+    txAddress = address;
+    txLength = 0;
+    pending = false;
+  }
+  size_t write(uint8_t data) {
+    if (txLength >= bufferLength) return 0;
+    txBuffer[txLength++] = data;
+    return 1;
+  }
+  size_t write(const uint8_t* data, size_t length) {
+    size_t n = 0;
+    while (n < length && write(data[n])) n++;
+    return n;
+  }
+
+  uint8_t endTransmission(bool sendStop = true) {
+    // ストップなしの場合は次の読み出しと合わせて転送する
+    if (!sendStop) {
+      pending = true;
+      return 0;
+    }
+    if (bus == nullptr) return 4;
+    return bus->transfer(txAddress, txBuffer, txLength, nullptr, 0);
+  }
+
+  uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop = 1) {
+    (void)sendStop;
+    rxLength = rxIndex = 0;
+    if (bus == nullptr || quantity > bufferLength) return 0;
+
+    // 保留中の書き込みがあればリピートスタートで続けて読み出す
+    bool combined = pending && txAddress == address;
+    pending = false;
+    uint8_t result = bus->transfer(address, combined ? txBuffer : nullptr, combined ? txLength : 0, rxBuffer, quantity);
+    if (result != 0) return 0;
+    rxLength = quantity;
+    return quantity;
+  }
+  uint8_t requestFrom(int address, int quantity) {
+    return requestFrom((uint8_t)address, (uint8_t)quantity);
+  }
+
+  int available() {
+    return (int)(rxLength - rxIndex);
+  }
+  int read() {
+    return (rxIndex < rxLength) ? rxBuffer[rxIndex++] : -1;
+  }
+
+private:
+  I2CBus* bus;                     // 転送先
+  uint8_t txAddress = 0;           // 送信先アドレス
+  uint8_t txBuffer[bufferLength];  // 送信バッファ
+  size_t txLength = 0;             // 送信データ長
+  bool pending = false;            // ストップなしで保留中の書き込みがあるか
+  uint8_t rxBuffer[bufferLength];  // 受信バッファ
+  size_t rxLength = 0;             // 受信データ長
+  size_t rxIndex = 0;              // 受信データの読み出し位置
+};
+
+inline TwoWire Wire;
+
+#endif
@@ -0,0 +1,196 @@
+/**
+ * @file core_check
+ * @brief 判定処理（MPR121_Core.h）単体での動的確保の確認
+ * @details MPR121_Core.hのみをインクルードし、グローバルのoperator newを置き換えて確保の回数を数える。
+ *          begin／detect／restart、saveState／loadState、saveConfig／loadConfigとイベント出力を一通り動かし、
+ *          1回でも動的確保が発生した場合、または状態・設定データの読み書きに失敗した場合は終了コード1を返す。
+ *          あわせて、安定したポートの処理の省略（idlePort）が判定結果を変えないことを、毎回setAlpha()で省略を
+ *          無効にした判定処理と同じ計測値で比較して確認し、1回でも状態が異なれば終了コード1を返す。
+ *          Arduinoの型や標準C++ライブラリに依存していないことの確認も兼ねるため、C++11／17／20のそれぞれでビルドして実行する。
+ *
+ * @section ビルド（リポジトリのルートで実行）
+ *    g++ -std=c++11 -O2 -I . host/core_check.cpp -o core_check
+ *    g++ -std=c++20 -O2 -I . host/core_check.cpp -o core_check
+ *
+ * @section 使い方
+ *    ./core_check
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "MPR121_Core.h"
+
+// 動的確保の回数
+static unsigned long allocations = 0;
+
+void* operator new(size_t size) {
+  allocations++;
+  void* memory = malloc(size ? size : 1);
+  if (memory == nullptr) abort();
+  return memory;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+  free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+  free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+  free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+  free(memory);
+}
+
+//*****************************************************************************************************************************
+// 発生したイベントを数える出力先
+struct EventCounter : public MPR121EventSink {
+  unsigned long events = 0;
+
+  void onEvent(const MPR121Event&) override {
+    events++;
+  }
+};
+
+//*****************************************************************************************************************************
+// 省略中のポートを参照できるようにした判定処理
+struct IdleProbe : public MPR121Detector {
+  IdleProbe() : MPR121Detector(0x0FFF) {}
+
+  uint16_t getIdlePorts() {
+    return idlePort;
+  }
+};
+
+// 比較用の擬似乱数（線形合同法）
+static uint32_t randomState = 1;
+
+static uint32_t nextRandom(uint32_t range) {
+  randomState = randomState * 1103515245u + 12345u;
+  return (randomState >> 16) % range;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 処理の省略あり・なしの判定処理に同じ計測値を与え、全ポートの判定状態が毎回一致するか確認する
+ * @param mode 判定方式
+ * @param decimation 判定の間引き率
+ * @param skipped 省略されたポート数の加算先（確認が省略の経路を通ったかの目安）
+ * @return すべての更新で判定状態が一致した場合はtrue
+ */
+//*****************************************************************************************************************************
+static bool checkIdleSkip(uint8_t mode, uint8_t decimation, unsigned long& skipped) {
+  const float alpha = 0.6;
+  IdleProbe fast;
+  IdleProbe reference;
+  MPR121Detector* detectors[2] = { &fast, &reference };
+  for (MPR121Detector* detector : detectors) {
+    detector->setDetectMode(mode);
+    detector->setDecimation(decimation);
+    detector->setAlpha(alpha);
+    detector->setPredictSlope(1, 5);
+    detector->setPredictSlope(2, 5);
+    detector->setPredictSlope(4, 5);
+    detector->setReleaseRatio(2, 40);
+    detector->setReleaseRatio(3, 40);
+    detector->setPipeline(4, MPR121Detector::PIPELINE_RAW);
+    detector->setPipeline(5, MPR121Detector::PIPELINE_CLAMP);
+    detector->setPipeline(6, MPR121Detector::PIPELINE_FILTER);
+  }
+
+  // ポートごとに一定値（非タッチ・タッチ・閾値付近・浅い接近・範囲外）、ノイズの区間をランダムな長さで続ける
+  static const uint16_t levels[5] = { 680, 620, 649, 660, 720 };
+  uint16_t filtered[12], baseline[12], segment[12] = {}, kind[12] = {};
+  for (uint8_t i = 0; i < 12; i++) filtered[i] = baseline[i] = 680;
+  fast.begin(filtered, baseline);
+  reference.begin(filtered, baseline);
+
+  for (uint32_t scan = 0; scan < 100000; scan++) {
+    for (uint8_t i = 0; i < 12; i++) {
+      if (segment[i] == 0) {
+        segment[i] = 1 + nextRandom(400);
+        kind[i] = nextRandom(6);
+      }
+      segment[i]--;
+      filtered[i] = (kind[i] < 5) ? levels[kind[i]] : 678 + nextRandom(5);
+      if (nextRandom(2000) == 0) baseline[i] += (nextRandom(2) == 0) ? 1 : -1;
+    }
+
+    // 比較側は毎回setAlpha()で省略を無効にする
+    uint16_t idle = fast.getIdlePorts();
+    for (uint8_t i = 0; i < 12; i++) skipped += (idle >> i) & 1;
+    reference.setAlpha(alpha);
+    fast.detect(scan * 2000, filtered, baseline);
+    reference.detect(scan * 2000, filtered, baseline);
+
+    for (uint8_t i = 0; i < 12; i++) {
+      MPR121PortState expected = {}, actual = {};
+      reference.getPortState(i, expected);
+      fast.getPortState(i, actual);
+      if (actual != expected) {
+        printf("idle skip: mode %u, decimation %u, scan %lu, port %u differs\n", mode, decimation,
+               (unsigned long)scan, i);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+//*****************************************************************************************************************************
+// メイン処理
+int main() {
+  uint16_t filtered[12], baseline[12];
+  for (uint8_t i = 0; i < 12; i++) filtered[i] = baseline[i] = 680;
+
+  // 判定処理の作成と設定（仮タッチ・動的ヒステリシス・マトリクスも有効にする）
+  unsigned long before = allocations;
+  MPR121Detector detector(0x0FFF);
+  EventCounter counter;
+  detector.setEventSink(&counter);
+  detector.setPredictSlope(2, 5);
+  detector.setReleaseRatio(3, 40);
+  const uint8_t rows[2] = { 0, 1 };
+  const uint8_t cols[2] = { 2, 3 };
+  detector.setMatrix(rows, 2, cols, 2);
+  detector.begin(filtered, baseline);
+
+  // 周期的なタッチを与えて判定し、途中で状態・設定データの読み書きと判定のやり直しを行う
+  uint8_t state[MPR121Detector::stateMaxSize];
+  uint8_t config[MPR121Detector::configSize];
+  bool stored = true;
+  for (uint32_t scan = 0; scan < 200000; scan++) {
+    for (uint8_t i = 0; i < 12; i++) filtered[i] = ((scan / 500 + i) % 3 == 0) ? 620 : 680 + (scan * 7 + i) % 3;
+    detector.detect(scan * 2000, filtered, baseline);
+
+    if (scan % 1000 == 0) {
+      size_t stateSize = detector.saveState(state, sizeof(state));
+      size_t configSize = detector.saveConfig(config, sizeof(config));
+      stored = stored && stateSize > 0 && detector.loadState(state, stateSize);
+      stored = stored && configSize > 0 && detector.loadConfig(config, configSize);
+    }
+    if (scan % 50000 == 25000) detector.restart(filtered, baseline);
+  }
+  unsigned long used = allocations - before;
+
+  printf("events %lu, allocations %lu, state/config %s\n", counter.events, used, stored ? "ok" : "NG");
+
+  // 両方の判定方式、間引きの有無で処理の省略による差がないことを確認する
+  bool same = true;
+  unsigned long skipped = 0;
+  for (uint8_t mode = MPR121Detector::DETECT_FILTERED; mode <= MPR121Detector::DETECT_BASELINE; mode++) {
+    for (uint8_t decimation = 1; decimation <= 3; decimation += 2) {
+      same = checkIdleSkip(mode, decimation, skipped) && same;
+    }
+  }
+  printf("idle skip: %lu port scans skipped, %s\n", skipped, same ? "ok" : "NG");
+  return (used == 0 && stored && counter.events > 0 && same && skipped > 0) ? 0 : 1;
+}
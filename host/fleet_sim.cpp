@@ -0,0 +1,286 @@
+/**
+ * @file fleet_sim
+ * @brief 複数基板・複数バス構成のスキャン性能シミュレーター
+ * @details 模擬MPR121（MPR121Mock）をI2Cバスシミュレーター（SimBus）に接続し、基板ごとのMPR121Managerを
+ *          仮想時刻上で巡回更新して、スキャンレート・スキャン周期・タッチ検出遅延を集計する。
+ *          バスごとに独立したコントローラー（とupdate()を行う処理）を持つ構成として、各バスの基板は並行して更新し、
+ *          巡回の所要時間は最も遅いバスで決まる。
+ *          ハードウェアを用意する前に、バス構成・クロック速度・基板数の妥当性を確認するために使用する。
+ *
+ * @section ビルド（リポジトリのルートで実行）
+ *    g++ -std=c++17 -O2 -I host -I . host/fleet_sim.cpp MPR121_Control.cpp MPR121_Output.cpp -o fleet_sim
+ *
+ * @section 使い方
+ *    ./fleet_sim --boards 8 --buses 2 --clock 400000 --latency 20 --error 0.001 --seconds 10 --touches 200
+ *    --boards N        基板数（1バスあたり最大4枚：0x5A～0x5D）
+ *    --buses N         I2Cバス数（基板は順番に割り当てる）
+ *    --clock HZ        I2Cクロック速度
+ *    --latency US      トランザクションごとの遅延
+ *    --error RATE      転送失敗の確率（0～1）
+ *    --update-cost US  update()1回あたりのマイコンの処理時間（バスごとに加算）
+ *    --seconds S       シミュレーション時間
+ *    --touches N       注入するタッチ数（全基板の合計）
+ *    --unplug MS       指定時刻に最後の基板を抜き、1秒後に戻す（0で無効）
+ *    --seed N          乱数の種
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+#include "Options.h"
+#include "MPR121_Config.h"
+#include "SimBus.h"
+
+//*****************************************************************************************************************************
+// 設定
+struct Options {
+  int boards = 4;           // 基板数
+  int buses = 1;            // バス数
+  uint32_t clock = 400000;  // クロック速度[Hz]
+  uint32_t latency = 0;     // トランザクションごとの遅延[us]
+  double error = 0.0;       // 転送失敗の確率
+  uint32_t updateCost = 0;  // update()1回あたりの処理時間[us]
+  double seconds = 10.0;    // シミュレーション時間[s]
+  int touches = 100;        // 注入するタッチ数
+  uint32_t unplug = 0;      // 基板を抜く時刻[ms]
+  uint32_t seed = 1;        // 乱数の種
+};
+
+// 注入したタッチ
+struct Touch {
+  int board;              // 基板番号
+  uint8_t port;           // ポート番号
+  uint64_t start;         // タッチ開始時刻[us]
+  uint64_t end;           // タッチ終了時刻[us]
+  uint64_t detected = 0;  // タッチを検出した時刻[us]
+  uint64_t released = 0;  // リリースを検出した時刻[us]
+};
+
+static const float levelIdle = 700;   // 非タッチ時の計測値
+static const float levelTouch = 640;  // タッチ時の計測値
+static const float noiseSigma = 1.5;  // 計測ノイズの標準偏差
+
+//*****************************************************************************************************************************
+/**
+ * @brief 昇順に並べた値から百分位数を求める
+ */
+//*****************************************************************************************************************************
+template <class T>
+static T percentile(const std::vector<T>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  size_t index = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 百分位数をまとめて表示する
+ */
+//*****************************************************************************************************************************
+template <class T>
+static void printPercentile(const char* label, std::vector<T> values, double scale, const char* unit) {
+  std::sort(values.begin(), values.end());
+  printf("  %-18s n=%-8zu p50=%.2f p90=%.2f p99=%.2f max=%.2f %s\n", label, values.size(),
+         percentile(values, 50) * scale, percentile(values, 90) * scale, percentile(values, 99) * scale,
+         (values.empty() ? 0 : values.back()) * scale, unit);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief コマンドライン引数を読み取る
+ */
+//*****************************************************************************************************************************
+static bool parseOptions(int argc, char** argv, Options& options) {
+  bool parsed = parseOptionPairs(argc, argv, [&](const std::string& key, const std::string& value) {
+    if (key == "--boards") options.boards = atoi(value.c_str());
+    else if (key == "--buses") options.buses = atoi(value.c_str());
+    else if (key == "--clock") options.clock = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--latency") options.latency = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--error") options.error = atof(value.c_str());
+    else if (key == "--update-cost") options.updateCost = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--seconds") options.seconds = atof(value.c_str());
+    else if (key == "--touches") options.touches = atoi(value.c_str());
+    else if (key == "--unplug") options.unplug = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--seed") options.seed = strtoul(value.c_str(), nullptr, 10);
+    else return false;
+    return true;
+  });
+  if (!parsed) return false;
+  if (options.boards < 1 || options.buses < 1 || options.boards > options.buses * 4) {
+    fprintf(stderr, "boards must be 1..%d (4 addresses per bus)\n", options.buses * 4);
+    return false;
+  }
+  return true;
+}
+
+//*****************************************************************************************************************************
+// メイン処理
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) return 1;
+
+  HostClock::simulated = true;
+  std::mt19937 random(options.seed);
+  std::normal_distribution<float> noise(0.0f, noiseSigma);
+
+  // タッチを生成（同じ電極で重ならないように配置）
+  const uint64_t duration = (uint64_t)(options.seconds * 1000000);
+  std::vector<Touch> touches;
+  std::vector<std::vector<Touch*>> touchMap(options.boards * 12);
+  touches.reserve(options.touches);
+  std::uniform_int_distribution<int> pickBoard(0, options.boards - 1);
+  std::uniform_int_distribution<int> pickPort(0, 11);
+  std::uniform_int_distribution<uint64_t> pickStart(500000, duration > 1000000 ? duration - 500000 : 500000);
+  std::uniform_int_distribution<uint64_t> pickLength(100000, 400000);
+  for (int n = 0, tries = 0; n < options.touches && tries < options.touches * 20; tries++) {
+    Touch touch;
+    touch.board = pickBoard(random);
+    touch.port = pickPort(random);
+    touch.start = pickStart(random);
+    touch.end = touch.start + pickLength(random);
+
+    bool overlap = false;
+    for (const Touch& other : touches) {
+      if (other.board == touch.board && other.port == touch.port &&
+          touch.start < other.end + 200000 && other.start < touch.end + 200000) overlap = true;
+    }
+    if (overlap) continue;
+    touches.push_back(touch);
+    n++;
+  }
+  for (Touch& touch : touches) touchMap[touch.board * 12 + touch.port].push_back(&touch);
+
+  // バスと模擬デバイスを作成
+  std::vector<std::unique_ptr<SimBus>> buses;
+  std::vector<std::unique_ptr<TwoWire>> wires;
+  for (int b = 0; b < options.buses; b++) {
+    buses.emplace_back(new SimBus(options.clock, options.latency, options.error, options.seed + b));
+    wires.emplace_back(new TwoWire(buses.back().get()));
+  }
+
+  std::vector<std::unique_ptr<MPR121Mock>> mocks;
+  for (int d = 0; d < options.boards; d++) {
+    mocks.emplace_back(new MPR121Mock(0x5A + d / options.buses));
+    const std::vector<Touch*>* map = &touchMap[d * 12];
+    mocks.back()->setSource([map, &noise, &random](uint8_t electrode, uint64_t time) {
+      float level = levelIdle;
+      for (const Touch* touch : map[electrode]) {
+        if (touch->start <= time && time < touch->end) level = levelTouch;
+      }
+      return level + noise(random);
+    });
+    buses[d % options.buses]->attach(mocks.back().get());
+  }
+
+  // 基板ごとのマネージャーを作成（起動待ちの分だけ仮想時刻が進む）
+  std::vector<std::unique_ptr<MPR121Manager>> managers;
+  for (int d = 0; d < options.boards; d++) {
+    managers.emplace_back(new MPR121Manager(0x5A + d / options.buses, 0x0FFF, wires[d % options.buses].get()));
+  }
+
+  // 仮想時刻をタッチ生成時の基準に合わせる（起動時の転送はバス使用率から除く）
+  const uint64_t origin = HostClock::now;
+  std::vector<uint64_t> busyAtOrigin;
+  for (auto& bus : buses) busyAtOrigin.push_back(bus->getStats().busyTime);
+  for (Touch& touch : touches) {
+    touch.start += origin;
+    touch.end += origin;
+  }
+
+  // 巡回更新
+  std::vector<uint64_t> lastUpdate(options.boards, 0);
+  std::vector<uint16_t> lastTouched(options.boards, 0);
+  std::vector<uint64_t> periods, touchLatency, releaseLatency;
+  uint64_t updates = 0, falseTouches = 0, cpuTime = 0;
+  bool unplugged = false, replugged = false;
+  const int unplugBoard = options.boards - 1;
+
+  while (HostClock::now - origin < duration) {
+    uint64_t roundStart = HostClock::now;
+    uint64_t elapsed = (roundStart - origin) / 1000;
+
+    // 基板の抜き差し
+    if (options.unplug > 0 && !unplugged && elapsed >= options.unplug) {
+      buses[unplugBoard % options.buses]->setConnected(mocks[unplugBoard]->getAddress(), false);
+      unplugged = true;
+    }
+    if (unplugged && !replugged && elapsed >= options.unplug + 1000) {
+      buses[unplugBoard % options.buses]->setConnected(mocks[unplugBoard]->getAddress(), true);
+      replugged = true;
+    }
+
+    // バスごとに接続した基板を順に更新する（各バスは巡回の開始時刻から並行して転送する）
+    uint64_t roundEnd = roundStart;
+    for (int b = 0; b < options.buses; b++) {
+      buses[b]->enter(roundStart);
+      for (int d = b; d < options.boards; d += options.buses) {
+        auto cpuStart = std::chrono::steady_clock::now();
+        managers[d]->update();
+        cpuTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - cpuStart).count();
+        HostClock::advance(options.updateCost);
+        updates++;
+
+        uint64_t now = HostClock::now;
+        if (lastUpdate[d] != 0) periods.push_back(now - lastUpdate[d]);
+        lastUpdate[d] = now;
+
+        // タッチ状態の変化を注入したタッチと照合
+        for (uint8_t p = 0; p < 12; p++) {
+          bool touched = managers[d]->isTouched(p);
+          bool before = (lastTouched[d] >> p) & 1;
+          if (touched == before) continue;
+          lastTouched[d] ^= (1 << p);
+
+          Touch* match = nullptr;
+          for (Touch* touch : touchMap[d * 12 + p]) {
+            if (touched && touch->detected == 0 && touch->start <= now && now < touch->end + 500000) match = touch;
+            if (!touched && touch->detected != 0 && touch->released == 0) match = touch;
+          }
+          if (match == nullptr) {
+            if (touched) falseTouches++;
+            continue;
+          }
+          if (touched) {
+            match->detected = now;
+            touchLatency.push_back(now - match->start);
+          } else {
+            match->released = now;
+            if (now > match->end) releaseLatency.push_back(now - match->end);
+          }
+        }
+      }
+      roundEnd = std::max(roundEnd, buses[b]->leave());
+    }
+    HostClock::now = roundEnd;
+
+    // 全基板が未接続などで時刻が進まない場合の保険
+    if (HostClock::now == roundStart) HostClock::advance(1);
+  }
+
+  // 結果の表示
+  double simSeconds = duration / 1000000.0;
+  int missed = 0;
+  for (const Touch& touch : touches) missed += (touch.detected == 0);
+
+  printf("config: boards=%d buses=%d clock=%u latency=%uus error=%g update-cost=%uus\n", options.boards, options.buses,
+         options.clock, options.latency, options.error, options.updateCost);
+  printf("scan:\n");
+  printf("  updates            %llu (%.1f /s total, %.1f /s per board)\n", (unsigned long long)updates,
+         updates / simSeconds, updates / simSeconds / options.boards);
+  printPercentile("period", periods, 1.0, "us");
+  printf("  host cpu           %.0f ns/update\n", updates ? (double)cpuTime / updates : 0.0);
+  printf("touch:\n");
+  printf("  injected           %zu (missed %d, false %llu)\n", touches.size(), missed, (unsigned long long)falseTouches);
+  printPercentile("touch latency", touchLatency, 0.001, "ms");
+  printPercentile("release latency", releaseLatency, 0.001, "ms");
+  printf("bus:\n");
+  for (int b = 0; b < options.buses; b++) {
+    const SimBus::Stats& stats = buses[b]->getStats();
+    printf("  bus%-2d utilisation %.1f%%  transactions %llu  bytes %llu  nacks %llu  errors %llu\n", b,
+           100.0 * (stats.busyTime - busyAtOrigin[b]) / (HostClock::now - origin), (unsigned long long)stats.transactions,
+           (unsigned long long)stats.bytes, (unsigned long long)stats.nacks, (unsigned long long)stats.errors);
+  }
+  return 0;
+}
@@ -0,0 +1,186 @@
+/**
+ * @file log_tool
+ * @brief 計測値記録ファイルの変換・確認ツール
+ * @details MPR121Loggerの記録ファイル（.mlog）とCSV形式のトレースを相互に変換し、容量を確認する。
+ *
+ * @section ビルド（リポジトリのルートで実行）
+ *    g++ -std=c++17 -O2 -I host -I . host/log_tool.cpp MPR121_Log.cpp MPR121_Control.cpp MPR121_Output.cpp -o log_tool
+ *
+ * @section 使い方
+ *    ./log_tool encode trace.csv touch.mlog          CSVトレースを記録ファイルに変換（MPR121Loggerで書き込み）
+ *    ./log_tool decode touch.mlog trace.csv [開始us 終了us]  記録ファイルの指定範囲をCSVトレースに変換
+ *    ./log_tool info touch.mlog                      ブロック数・スキャン数・1スキャンあたりの容量を表示
+ *    ./log_tool demo touch.mlog [秒]                 合成信号（stepシナリオ）を記録して容量を比較
+ */
+
+#include <chrono>
+#include <string>
+#include "LogReader.h"
+#include "MPR121_Log.h"
+
+//*****************************************************************************************************************************
+// ファイル出力（MPR121Loggerの出力先）
+class FilePrint : public Print {
+public:
+  FilePrint(FILE* setFile)
+    : file(setFile) {}
+  size_t write(uint8_t c) override {
+    return fputc(c, file) == EOF ? 0 : 1;
+  }
+  size_t write(const uint8_t* buffer, size_t size) override {
+    return fwrite(buffer, 1, size, file);
+  }
+
+private:
+  FILE* file;
+};
+
+//*****************************************************************************************************************************
+/**
+ * @brief トレースを記録ファイルに書き込む
+ */
+//*****************************************************************************************************************************
+static bool writeLog(const Trace& trace, const std::string& path) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == nullptr) return false;
+  FilePrint output(file);
+  MPR121Logger logger(output);
+  logger.begin(trace.portMask);
+
+  uint16_t values[Trace::maxPort];
+  for (size_t n = 0; n < trace.size(); n++) {
+    uint8_t count = 0;
+    for (uint8_t port = 0; port < Trace::maxPort; port++) {
+      if ((trace.portMask >> port) & 1) values[count++] = trace.filteredAt(n)[port];
+    }
+    logger.log(trace.time[n], values, trace.touch[n]);
+  }
+  logger.finish();
+  return fclose(file) == 0;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief トレースをCSVに書き込む
+ */
+//*****************************************************************************************************************************
+static bool writeCsv(const Trace& trace, const std::string& path) {
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == nullptr) return false;
+  fprintf(file, "# time_us,touch_mask,v0..v11\n");
+  for (size_t n = 0; n < trace.size(); n++) {
+    fprintf(file, "%llu,0x%03X", (unsigned long long)trace.time[n], trace.touch[n]);
+    for (uint8_t port = 0; port < Trace::maxPort; port++) fprintf(file, ",%u", trace.filteredAt(n)[port]);
+    fprintf(file, "\n");
+  }
+  return fclose(file) == 0;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 記録ファイルの概要を表示する
+ */
+//*****************************************************************************************************************************
+static int showInfo(const std::string& path) {
+  LogReader reader;
+  if (!reader.open(path)) {
+    fprintf(stderr, "cannot open log: %s\n", path.c_str());
+    return 1;
+  }
+
+  size_t blocks = 0, scans = 0;
+  uint64_t firstTime = 0, lastTime = 0;
+  LogReader::Block block;
+  for (bool valid = reader.first(block); valid; valid = reader.next(block)) {
+    if (blocks == 0) firstTime = block.time;
+    lastTime = block.time;
+    blocks++;
+    scans += block.scans;
+  }
+
+  uint8_t ports = 0;
+  for (uint8_t port = 0; port < Trace::maxPort; port++) ports += (reader.getPortMask() >> port) & 1;
+
+  // printStatus()の1行あたりの文字数（"  |  Port N: Release  Val: 700.00  Thr: 670.00  Raw: 700"程度）との比較
+  const double statusBytes = 16 + ports * 56.0;
+  double perScan = scans ? (double)reader.getDataSize() / scans : 0;
+  printf("ports 0x%03X, %zu blocks, %zu scans, %.1f s, index %s\n", reader.getPortMask(), blocks, scans,
+         (lastTime - firstTime) / 1e6, reader.hasIndex() ? "yes" : "no (scanned block headers)");
+  printf("%zu bytes, %.2f bytes/scan (printStatus text ~%.0f bytes/scan, %.1fx smaller)\n", reader.getDataSize(),
+         perScan, statusBytes, perScan > 0 ? statusBytes / perScan : 0.0);
+  return 0;
+}
+
+//*****************************************************************************************************************************
+// メイン処理
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: log_tool encode|decode|info|demo ...\n");
+    return 1;
+  }
+  std::string command = argv[1];
+
+  if (command == "encode" && argc >= 4) {
+    Trace trace;
+    if (!loadTraceCsv(argv[2], trace)) {
+      fprintf(stderr, "cannot load trace: %s\n", argv[2]);
+      return 1;
+    }
+    if (!writeLog(trace, argv[3])) {
+      fprintf(stderr, "cannot write: %s\n", argv[3]);
+      return 1;
+    }
+    return showInfo(argv[3]);
+  }
+
+  if (command == "decode" && (argc == 4 || argc == 6)) {
+    LogReader reader;
+    if (!reader.open(argv[2])) {
+      fprintf(stderr, "cannot open log: %s\n", argv[2]);
+      return 1;
+    }
+    uint64_t start = argc == 6 ? strtoull(argv[4], nullptr, 10) : 0;
+    uint64_t stop = argc == 6 ? strtoull(argv[5], nullptr, 10) : UINT64_MAX;
+    Trace trace;
+    auto startTime = std::chrono::steady_clock::now();
+    reader.read(start, stop, trace);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    printf("%zu scans decoded in %.3f s\n", trace.size(), elapsed);
+    if (!writeCsv(trace, argv[3])) {
+      fprintf(stderr, "cannot write: %s\n", argv[3]);
+      return 1;
+    }
+    return 0;
+  }
+
+  if (command == "info") return showInfo(argv[2]);
+
+  if (command == "demo") {
+    double seconds = argc >= 4 ? atof(argv[3]) : 60;
+    uint64_t duration = (uint64_t)(seconds * 1000000);
+    SignalGenerator generator = SignalGenerator::preset("step", duration);
+    Trace trace = traceFromGenerator(generator, duration, 2000);
+    if (!writeLog(trace, argv[2])) {
+      fprintf(stderr, "cannot write: %s\n", argv[2]);
+      return 1;
+    }
+    int result = showInfo(argv[2]);
+
+    // 書き込んだ内容がそのまま復元できるか確認
+    LogReader reader;
+    Trace decoded;
+    reader.open(argv[2]);
+    reader.readAll(decoded);
+    bool same = decoded.time == trace.time && decoded.touch == trace.touch && decoded.filtered == trace.filtered;
+    printf("round trip: %s\n", same ? "identical" : "MISMATCH");
+    return same ? result : 1;
+  }
+
+  // 引数の数が合わない場合（decodeの範囲が片方のみなど）は使い方を表示
+  if (command == "encode" || command == "decode") {
+    fprintf(stderr, "usage: log_tool encode trace.csv touch.mlog | decode touch.mlog trace.csv [start-us stop-us]\n");
+    return 1;
+  }
+  fprintf(stderr, "unknown command: %s\n", command.c_str());
+  return 1;
+}
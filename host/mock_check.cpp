@@ -0,0 +1,326 @@
+/**
+ * @file mock_check
+ * @brief 模擬デバイスによる動作確認
+ * @details 模擬MPR121（MPR121Mock）をI2Cバスシミュレーター（SimBus）に接続してMPR121Managerを動かし、
+ *          異常監視・自動キャリブレーション設定・MIDI出力までの遅延など、チップとのやり取りを伴う動作を確認する。
+ *          確認項目ごとに結果を表示し、1件でも失敗した場合は終了コード1を返す。
+ *
+ * @section ビルド（リポジトリのルートで実行）
+ *    g++ -std=c++17 -O2 -I host -I . host/mock_check.cpp MPR121_Control.cpp MPR121_Output.cpp -o mock_check
+ *
+ * @section 使い方
+ *    ./mock_check
+ */
+
+#include <memory>
+#include <vector>
+#include "MPR121_Config.h"
+#include "SimBus.h"
+
+static const float levelIdle = 700;   // 非タッチ時の計測値
+static const float levelTouch = 640;  // タッチ時の計測値
+static const uint32_t scanPeriod = 2000;  // update()の呼び出し周期[us]
+
+static int failures = 0;  // 失敗した確認項目の数
+
+//*****************************************************************************************************************************
+// 送信したバイトと送信時刻を記録する出力先（MIDI出力の確認用）
+struct ByteLog : public Print {
+  std::vector<uint8_t> bytes;
+  std::vector<uint64_t> times;
+
+  size_t write(uint8_t c) override {
+    bytes.push_back(c);
+    times.push_back(HostClock::now);
+    return 1;
+  }
+};
+
+// 出力されたタッチイベントを記録する出力先
+struct EventLog : public MPR121EventSink {
+  std::vector<MPR121Event> events;
+
+  void onEvent(const MPR121Event& event) override {
+    events.push_back(event);
+  }
+
+  // 指定ポート・種別のイベントの件数
+  int count(uint8_t port, uint8_t type) const {
+    int n = 0;
+    for (const MPR121Event& event : events) n += (event.port == port && event.type == type);
+    return n;
+  }
+};
+
+//*****************************************************************************************************************************
+// 1基板の確認環境（模擬デバイスを接続したバスとマネージャー）
+struct Bench {
+  SimBus bus;
+  MPR121Mock mock;
+  TwoWire wire;
+  std::unique_ptr<MPR121Manager> manager;
+
+  Bench()
+    : wire(&bus) {
+    HostClock::simulated = true;
+    for (uint8_t i = 0; i < MPR121Mock::maxPort; i++) mock.setLevel(i, levelIdle);
+    bus.attach(&mock);
+    manager.reset(new MPR121Manager(mock.getAddress(), 0x0FFF, &wire));
+  }
+
+  // 一定周期でupdate()を指定回数呼ぶ
+  void scan(int count) {
+    for (int n = 0; n < count; n++) {
+      uint64_t start = HostClock::now;
+      manager->update();
+      if (HostClock::now - start < scanPeriod) HostClock::advance(scanPeriod - (HostClock::now - start));
+    }
+  }
+};
+
+//*****************************************************************************************************************************
+/**
+ * @brief 確認結果を表示する
+ */
+//*****************************************************************************************************************************
+static void check(const char* name, bool ok) {
+  printf("%s  %s\n", ok ? "ok" : "NG", name);
+  if (!ok) failures++;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 自動キャリブレーションで解除される範囲外は、1回のやり直しで復帰する
+ */
+//*****************************************************************************************************************************
+static void checkOutOfRangeRecovery() {
+  Bench bench;
+  bench.manager->setStatusCheckInterval(5);
+  bench.scan(50);
+
+  uint32_t before = bench.mock.getAutoConfigCount();
+  bench.mock.setOutOfRange(0x0004);
+  bench.scan(50);
+  uint32_t after = bench.mock.getAutoConfigCount();
+  check("oor recovery: recalibrated", after > before);
+  check("oor recovery: fault cleared", bench.manager->getFaultPort() == 0);
+
+  bench.scan(200);
+  check("oor recovery: no further recalibration", bench.mock.getAutoConfigCount() == after);
+
+  bench.mock.setLevel(2, levelTouch);
+  bench.scan(50);
+  check("oor recovery: recovered port detects touch", bench.manager->isTouched(2));
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief やり直しても解除されない範囲外は、そのポートのみ判定から外して他のポートの判定を続ける
+ */
+//*****************************************************************************************************************************
+static void checkOutOfRangePersistent() {
+  Bench bench;
+  bench.manager->setStatusCheckInterval(5);
+  bench.scan(50);
+
+  uint32_t before = bench.mock.getAutoConfigCount();
+  bench.mock.setOutOfRange(0x0004, false);
+  bench.scan(50);
+  uint32_t after = bench.mock.getAutoConfigCount();
+  check("oor persistent: recalibrated once", after > before);
+  check("oor persistent: port kept as fault", bench.manager->getFaultPort() == 0x0004);
+
+  // 正常なポートのタッチは状態確認をまたいでも維持される
+  bench.mock.setLevel(0, levelTouch);
+  bench.scan(50);
+  bool touched = bench.manager->isTouched(0);
+  for (int n = 0; n < 40; n++) {
+    bench.scan(5);
+    touched = touched && bench.manager->isTouched(0);
+  }
+  check("oor persistent: healthy touch held", touched);
+  check("oor persistent: no repeated recalibration", bench.mock.getAutoConfigCount() == after);
+  check("oor persistent: port still fault", bench.manager->getFaultPort() == 0x0004);
+
+  // 範囲内に戻ったポートは基板を再起動せずに判定を再開する
+  bench.mock.setOutOfRange(0);
+  bench.scan(10);
+  check("oor persistent: fault cleared after recovery", bench.manager->getFaultPort() == 0);
+  check("oor persistent: touch kept on recovery", bench.manager->isTouched(0));
+  bench.mock.setLevel(2, levelTouch);
+  bench.scan(50);
+  check("oor persistent: recovered port detects touch", bench.manager->isTouched(2));
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 過電流で停止した計測は、フラグを解除して再開する
+ */
+//*****************************************************************************************************************************
+static void checkOverCurrent() {
+  Bench bench;
+  bench.manager->setStatusCheckInterval(5);
+  bench.scan(50);
+
+  uint32_t before = bench.mock.getAutoConfigCount();
+  bench.mock.setOverCurrent();
+  bench.scan(50);
+  check("over current: measurement restarted", (bench.mock.getRegister(MPR121_ECR) & 0x3F) != 0);
+  check("over current: recalibrated", bench.mock.getAutoConfigCount() > before);
+  check("over current: flag cleared", !bench.manager->isOverCurrent());
+
+  bench.mock.setLevel(0, levelTouch);
+  bench.scan(50);
+  check("over current: touch detected after restart", bench.manager->isTouched(0));
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 電源電圧から求めた充電目標（USL／LSL／TL）が、停止中にAUTOCONFIG0より先に書き込まれる
+ * @details 模擬デバイスは計測中の書き込みを無視するため、値が反映されていれば停止中に書き込まれている
+ */
+//*****************************************************************************************************************************
+static void checkAutoConfigLimit() {
+  uint8_t usl = 0, lsl = 0, tl = 0;
+  bool calculated = MPR121Manager::calcAutoConfigLimit(3.3, 0.9, usl, lsl, tl);
+  check("autoconfig limit: 3.3V gives 201/131/181", calculated && usl == 201 && lsl == 131 && tl == 181);
+  check("autoconfig limit: out of range voltage rejected", !MPR121Manager::calcAutoConfigLimit(5.0, 0.9, usl, lsl, tl));
+
+  Bench bench;
+  bench.scan(10);
+  uint32_t before = bench.mock.getAutoConfigCount();
+  check("autoconfig limit: set", bench.manager->setAutoConfigLimit(3.3));
+  check("autoconfig limit: registers written", bench.mock.getRegister(MPR121_UPLIMIT) == 201
+                                                 && bench.mock.getRegister(MPR121_LOWLIMIT) == 131
+                                                 && bench.mock.getRegister(MPR121_TARGETLIMIT) == 181);
+
+  uint32_t autoConfigOrder = bench.mock.getWriteOrder(MPR121_AUTOCONFIG0);
+  bool ordered = true;
+  for (uint8_t reg = MPR121_UPLIMIT; reg <= MPR121_TARGETLIMIT; reg++) {
+    uint32_t order = bench.mock.getWriteOrder(reg);
+    ordered = ordered && order != 0 && order < autoConfigOrder;
+  }
+  check("autoconfig limit: written before AUTOCONFIG0", ordered);
+  check("autoconfig limit: used by autoconfig", bench.mock.getAutoConfigCount() > before
+                                                  && bench.mock.getAutoConfigLimit(MPR121_UPLIMIT) == 201
+                                                  && bench.mock.getAutoConfigLimit(MPR121_LOWLIMIT) == 131
+                                                  && bench.mock.getAutoConfigLimit(MPR121_TARGETLIMIT) == 181);
+
+  // 再キャリブレーション後も判定を再開する
+  bench.scan(20);
+  bench.mock.setLevel(0, levelTouch);
+  bench.scan(50);
+  check("autoconfig limit: touch detected after settle", bench.manager->isTouched(0));
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 模擬タッチからMIDIのノートオン／オフまでの遅延を確認する
+ * @details タッチ／リリース判定回数をjuge回とすると、計測値が変化してからjuge + 1回目の判定で確定する。
+ *          模擬デバイスの計測周期と平滑化の分を含め、juge + 2スキャン以内に送信されることを確認する。
+ */
+//*****************************************************************************************************************************
+static void checkMidiLatency() {
+  const uint8_t port = 3;
+  const uint8_t juge = 4;
+  const uint64_t touchStart = 200000;  // 確認開始からのタッチ開始時刻[us]
+  const uint64_t touchEnd = 400000;    // 確認開始からのタッチ終了時刻[us]
+
+  Bench bench;
+  bench.manager->setTouchJugeCount(port, juge);
+  bench.manager->setReleaseJugeCount(port, juge);
+  ByteLog serial;
+  MPR121MidiOut midiOut(serial, 1);
+  bench.manager->setEventSink(&midiOut);
+
+  uint64_t origin = HostClock::now;
+  bench.mock.setSource([origin, touchStart, touchEnd](uint8_t electrode, uint64_t time) {
+    bool touched = electrode == port && time >= origin + touchStart && time < origin + touchEnd;
+    return touched ? levelTouch : levelIdle;
+  });
+  bench.scan((int)((touchEnd + 200000) / scanPeriod));
+
+  const std::vector<uint8_t>& bytes = serial.bytes;
+  bool messages = bytes.size() == 6 && bytes[0] == 0x91 && bytes[1] == 60 + port && bytes[2] >= 1 && bytes[2] <= 127
+                  && bytes[3] == 0x81 && bytes[4] == 60 + port;
+  check("midi latency: note on/off bytes", messages);
+  if (!messages) return;
+
+  uint64_t onLatency = serial.times[0] - (origin + touchStart);
+  uint64_t offLatency = serial.times[3] - (origin + touchEnd);
+  printf("    note on %.1f ms, note off %.1f ms (scan %.1f ms)\n", onLatency / 1000.0, offLatency / 1000.0,
+         scanPeriod / 1000.0);
+  check("midi latency: note on within juge + 2 scans", onLatency >= juge * scanPeriod && onLatency <= (juge + 2) * scanPeriod);
+  check("midi latency: note off within juge + 2 scans", offLatency >= juge * scanPeriod && offLatency <= (juge + 2) * scanPeriod);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 切断・再キャリブレーションで解除されたタッチは、ノートオフが送信される
+ */
+//*****************************************************************************************************************************
+static void checkForcedRelease() {
+  // 再キャリブレーション（別ポートの範囲外）
+  {
+    Bench bench;
+    bench.manager->setStatusCheckInterval(5);
+    ByteLog serial;
+    MPR121MidiOut midiOut(serial);
+    bench.manager->setEventSink(&midiOut);
+    bench.scan(20);
+    bench.mock.setLevel(0, levelTouch);
+    bench.scan(50);
+    bool touched = bench.manager->isTouched(0);
+    bench.mock.setOutOfRange(0x0020);
+    bench.scan(50);
+    const std::vector<uint8_t>& bytes = serial.bytes;
+    check("forced release: note off on resettle", touched && !bench.manager->isTouched(0) && bytes.size() == 6
+                                                    && bytes[3] == 0x80 && bytes[4] == 60);
+  }
+
+  // 切断
+  {
+    Bench bench;
+    ByteLog serial;
+    MPR121MidiOut midiOut(serial);
+    bench.manager->setEventSink(&midiOut);
+    bench.scan(20);
+    bench.mock.setLevel(0, levelTouch);
+    bench.scan(50);
+    bool touched = bench.manager->isTouched(0);
+    bench.bus.setConnected(bench.mock.getAddress(), false);
+    bench.scan(20);
+    const std::vector<uint8_t>& bytes = serial.bytes;
+    check("forced release: note off on disconnect", touched && !bench.manager->isConnected() && bytes.size() == 6
+                                                      && bytes[3] == 0x80 && bytes[4] == 60);
+  }
+
+  // 仮タッチ中の再開始（判定処理のみ）
+  {
+    MPR121Detector detector(0x0001);
+    EventLog log;
+    detector.setEventSink(&log);
+    detector.setPredictSlope(0, 10);
+    uint16_t idle[12] = { 700 };
+    uint16_t falling[12] = { 660 };
+    detector.begin(idle);
+    detector.detect(1000, falling);
+    bool provisional = log.count(0, MPR121Event::TOUCH_BEGIN) == 1;
+    detector.restart(falling);
+    check("forced release: touch cancel on restart", provisional && log.count(0, MPR121Event::TOUCH_CANCEL) == 1);
+  }
+}
+
+//*****************************************************************************************************************************
+// メイン処理
+int main() {
+  checkOutOfRangeRecovery();
+  checkOutOfRangePersistent();
+  checkOverCurrent();
+  checkAutoConfigLimit();
+  checkMidiLatency();
+  checkForcedRelease();
+
+  printf("%d failed\n", failures);
+  return failures > 0 ? 1 : 0;
+}
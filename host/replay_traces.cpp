@@ -0,0 +1,166 @@
+/**
+ * @file replay_traces
+ * @brief 記録データの並列再生ツール
+ * @details 基板ごとのトレースをReplayEngineで 基板 × ポート に分けて並列に再生し、全基板のタッチ／リリースを時刻順に出力する。
+ *          フィルタや判定パラメータを変更した際の、蓄積した記録データ全体での回帰確認に使用する。
+ *
+ * @section ビルド（リポジトリのルートで実行）
+ *    g++ -std=c++17 -O2 -pthread -I host -I . host/replay_traces.cpp MPR121_Control.cpp MPR121_Output.cpp -o replay_traces
+ *
+ * @section 使い方
+ *    ./replay_traces --trace board0.csv,board1.csv --config config.bin --out events.csv --verify 1
+ *    --trace LIST       CSV形式のトレース（1ファイル1基板、Trace.h参照）
+ *    --scenario LIST    トレースの代わりに合成信号のシナリオを使用（1シナリオ1基板）
+ *    --seconds S        シナリオの長さ
+ *    --scan-us US       シナリオのスキャン周期
+ *    --config PATH      tune_paramsなどで作成した設定データ
+ *    --threads N        並列数（省略時はコア数）
+ *    --window N         チェックポイント（ポートの判定状態）を記録する間隔[スキャン数]
+ *    --verify 1         1スキャンずつの再生結果と一致するか、各ポートを中間のチェックポイントから再開した結果と一致するか確認する
+ *    --out PATH         イベントのCSV（時刻[us],基板,ポート,タッチ=1/リリース=0）の出力先
+ */
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include "Options.h"
+#include "ReplayEngine.h"
+
+//*****************************************************************************************************************************
+// 設定
+struct Options {
+  std::vector<std::string> trace;
+  std::vector<std::string> scenario;
+  double seconds = 600;
+  uint32_t scanPeriod = 2000;
+  std::string config;
+  unsigned threads = 0;
+  size_t window = 20000;
+  bool verify = false;
+  std::string out;
+};
+
+//*****************************************************************************************************************************
+/**
+ * @brief コマンドライン引数を読み取る
+ */
+//*****************************************************************************************************************************
+static bool parseOptions(int argc, char** argv, Options& options) {
+  return parseOptionPairs(argc, argv, [&](const std::string& key, const std::string& value) {
+    if (key == "--trace") options.trace = split(value);
+    else if (key == "--scenario") options.scenario = split(value);
+    else if (key == "--seconds") options.seconds = atof(value.c_str());
+    else if (key == "--scan-us") options.scanPeriod = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--config") options.config = value;
+    else if (key == "--threads") options.threads = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--window") options.window = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--verify") options.verify = atoi(value.c_str()) != 0;
+    else if (key == "--out") options.out = value;
+    else return false;
+    return true;
+  });
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 設定データを読み込む
+ */
+//*****************************************************************************************************************************
+static bool loadConfigFile(const std::string& path, std::vector<uint8_t>& blob) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr) return false;
+  blob.resize(MPR121Manager::configSize);
+  size_t size = fread(blob.data(), 1, blob.size(), file);
+  fclose(file);
+  return size == blob.size();
+}
+
+//*****************************************************************************************************************************
+// メイン処理
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) return 1;
+  if (options.trace.empty() && options.scenario.empty()) options.scenario = { "step", "slow", "drift", "hum" };
+
+  // トレースの読み込み（またはシナリオから作成）
+  std::vector<Trace> traces;
+  for (const std::string& path : options.trace) {
+    Trace trace;
+    if (!loadTraceCsv(path, trace)) {
+      fprintf(stderr, "cannot load trace: %s\n", path.c_str());
+      return 1;
+    }
+    traces.push_back(std::move(trace));
+  }
+  for (size_t n = 0; n < options.scenario.size(); n++) {
+    uint64_t duration = (uint64_t)(options.seconds * 1000000);
+    SignalGenerator generator = SignalGenerator::preset(options.scenario[n], duration, 0x0FFF, n + 1);
+    traces.push_back(traceFromGenerator(generator, duration, options.scanPeriod));
+    traces.back().name = options.scenario[n];
+  }
+
+  ReplayEngine engine(options.threads, options.window);
+  if (!options.config.empty()) {
+    std::vector<uint8_t> blob;
+    if (!loadConfigFile(options.config, blob)) {
+      fprintf(stderr, "cannot load config: %s\n", options.config.c_str());
+      return 1;
+    }
+    engine.setConfig(blob);
+  }
+
+  // 並列再生
+  auto startTime = std::chrono::steady_clock::now();
+  std::vector<ReplayEvent> events = engine.run(traces);
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+  const ReplayEngine::Stats& stats = engine.getStats();
+  printf("%zu boards, %zu shards, %zu scans in %.3f s (%.1f M scans/s)\n", traces.size(), stats.shards, stats.scans,
+         elapsed, stats.scans / elapsed / 1e6);
+  printf("shard work: %.3f s total, %.3f s longest (speedup limit %.1fx)\n", stats.work, stats.longest,
+         stats.longest > 0 ? stats.work / stats.longest : 0.0);
+  printf("checkpoints: %zu port states recorded\n", stats.checkpoints);
+  printf("events: %zu\n", events.size());
+
+  // 1スキャンずつの再生結果との比較
+  if (options.verify) {
+    startTime = std::chrono::steady_clock::now();
+    std::vector<ReplayEvent> expected = engine.runSequential(traces);
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    bool same = (expected == events);
+    printf("sequential: %zu events in %.3f s -> %s\n", expected.size(), elapsed, same ? "identical" : "MISMATCH");
+
+    // 各ポートを中間の区間のチェックポイントから再開し、同じ範囲のイベントと比較
+    size_t resumed = 0, mismatched = 0;
+    for (size_t board = 0; board < traces.size(); board++) {
+      size_t index = traces[board].size() / engine.getWindow() / 2;
+      if (index == 0) continue;
+      uint64_t from = traces[board].time[index * engine.getWindow()];
+      for (uint8_t port = 0; port < Trace::maxPort; port++) {
+        if (engine.getCheckpoint(board, port, index) == nullptr) continue;
+        std::vector<ReplayEvent> part;
+        for (const ReplayEvent& event : events) {
+          if (event.board == board && event.port == port && event.time > from) part.push_back(event);
+        }
+        resumed++;
+        mismatched += (engine.replayFrom(traces, board, port, index) != part);
+      }
+    }
+    printf("checkpoint resume: %zu ports -> %s\n", resumed, mismatched == 0 ? "identical" : "MISMATCH");
+    if (!same || mismatched > 0) return 1;
+  }
+
+  if (!options.out.empty()) {
+    FILE* file = fopen(options.out.c_str(), "w");
+    if (file == nullptr) {
+      fprintf(stderr, "cannot write: %s\n", options.out.c_str());
+      return 1;
+    }
+    fprintf(file, "# time_us,board,port,touched\n");
+    for (const ReplayEvent& event : events) {
+      fprintf(file, "%llu,%u,%u,%d\n", (unsigned long long)event.time, event.board, event.port, event.touched);
+    }
+    fclose(file);
+  }
+  return 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file signal_bench
+ * @brief 合成信号による判定パラメータの評価
+ * @details SignalGeneratorのプリセットシナリオごとに、判定パラメータの全組み合わせでMPR121Managerを実行し、
+ *          検出率・誤検出・チャタリング・タッチ／リリース検出遅延を一覧で表示する。
+ *
+ * @section ビルド（リポジトリのルートで実行）
+ *    g++ -std=c++17 -O2 -I host -I . host/signal_bench.cpp MPR121_Control.cpp MPR121_Output.cpp -o signal_bench
+ *
+ * @section 使い方
+ *    ./signal_bench --scenario step,slow,water --touch-juge 5,10,15 --mode filtered,baseline
+ *    --scenario LIST        シナリオ（step,slow,shallow,drift,hum,water、省略時は全て）
+ *    --seconds S            1シナリオの長さ
+ *    --scan-us US           update()の呼び出し周期
+ *    --touch-margin LIST    タッチマージン
+ *    --release-margin LIST  リリースマージン
+ *    --touch-juge LIST      タッチ判定の回数
+ *    --release-juge LIST    リリース判定の回数
+ *    --mode LIST            判定方式（filtered,baseline）
+ *    --seed N               乱数の種
+ */
+
+#include <string>
+#include <vector>
+#include "Options.h"
+#include "Scorer.h"
+
+//*****************************************************************************************************************************
+// 設定
+struct Options {
+  std::vector<std::string> scenario = { "step", "slow", "shallow", "drift", "hum", "water" };
+  double seconds = 20;
+  uint32_t scanPeriod = 2000;
+  std::vector<int> touchMargin = { 30 };
+  std::vector<int> releaseMargin = { 20 };
+  std::vector<int> touchJuge = { 15 };
+  std::vector<int> releaseJuge = { 15 };
+  std::vector<std::string> mode = { "filtered" };
+  uint32_t seed = 1;
+};
+
+static std::vector<int> splitInt(const std::string& text) {
+  std::vector<int> values;
+  for (const std::string& item : split(text)) values.push_back(atoi(item.c_str()));
+  return values;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief コマンドライン引数を読み取る
+ */
+//*****************************************************************************************************************************
+static bool parseOptions(int argc, char** argv, Options& options) {
+  return parseOptionPairs(argc, argv, [&](const std::string& key, const std::string& value) {
+    if (key == "--scenario") options.scenario = split(value);
+    else if (key == "--seconds") options.seconds = atof(value.c_str());
+    else if (key == "--scan-us") options.scanPeriod = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--touch-margin") options.touchMargin = splitInt(value);
+    else if (key == "--release-margin") options.releaseMargin = splitInt(value);
+    else if (key == "--touch-juge") options.touchJuge = splitInt(value);
+    else if (key == "--release-juge") options.releaseJuge = splitInt(value);
+    else if (key == "--mode") options.mode = split(value);
+    else if (key == "--seed") options.seed = strtoul(value.c_str(), nullptr, 10);
+    else return false;
+    return true;
+  });
+}
+
+//*****************************************************************************************************************************
+// メイン処理
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) return 1;
+
+  const uint64_t duration = (uint64_t)(options.seconds * 1000000);
+  const uint16_t portMask = 0x0FFF;
+  const double minutes = options.seconds / 60.0;
+
+  printf("%-8s %-8s %4s %4s %4s %4s | %9s %6s %7s %7s | %9s %9s %9s\n", "scenario", "mode", "tm", "rm", "tj", "rj",
+         "detected", "false", "false/m", "chatter", "touch p50", "touch p90", "rel p50");
+
+  for (const std::string& scenario : options.scenario) {
+    for (const std::string& mode : options.mode) {
+      for (int tm : options.touchMargin) {
+        for (int rm : options.releaseMargin) {
+          for (int tj : options.touchJuge) {
+            for (int rj : options.releaseJuge) {
+              SignalGenerator generator = SignalGenerator::preset(scenario, duration, portMask, options.seed);
+              std::vector<TouchTransition> transitions = runScenario(generator, duration, options.scanPeriod, portMask, [&](MPR121Manager& manager) {
+                if (mode == "baseline") manager.setDetectMode(MPR121Manager::DETECT_BASELINE);
+                for (uint8_t port = 0; port < 12; port++) {
+                  manager.setTouchMargin(port, tm);
+                  manager.setReleaseMargin(port, rm);
+                  manager.setTouchJugeCount(port, tj);
+                  manager.setReleaseJugeCount(port, rj);
+                }
+              });
+              TouchScore score = scoreTransitions(generator.getLabels(), transitions);
+
+              char detected[24];
+              snprintf(detected, sizeof(detected), "%zu/%zu", score.detected, score.labels);
+              printf("%-8s %-8s %4d %4d %4d %4d | %9s %6zu %7.1f %7zu | %7.1fms %7.1fms %7.1fms\n", scenario.c_str(),
+                     mode.c_str(), tm, rm, tj, rj, detected, score.falseTouches, score.falseTouches / minutes, score.chatter,
+                     TouchScore::percentile(score.touchLatency, 50) / 1000.0,
+                     TouchScore::percentile(score.touchLatency, 90) / 1000.0,
+                     TouchScore::percentile(score.releaseLatency, 50) / 1000.0);
+            }
+          }
+        }
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,238 @@
+/**
+ * @file timeline
+ * @brief タッチイベントのタイムライン出力と遅延の解析ツール
+ * @details 記録データ（.csv／.mlog／.mtrc）または合成信号のシナリオを再生し、ポートごとのタッチイベントを
+ *          時刻順のCSVに、タッチ／リリース検出遅延の分布・チャタリング・押しっぱなしの時間をJSONに出力する。
+ *          正解ラベルには記録されたタッチ状態（シナリオの場合は合成信号のラベル）を使用する。
+ *
+ * @section ビルド（リポジトリのルートで実行）
+ *    g++ -std=c++17 -O2 -I host -I . host/timeline.cpp MPR121_Control.cpp MPR121_Output.cpp -o timeline
+ *
+ * @section 使い方
+ *    ./timeline --input touch.mlog --csv events.csv --json summary.json
+ *    --input PATH       記録データ（.csv／.mlog／.mtrc）
+ *    --scenario NAME    記録データの代わりに合成信号のシナリオを使用
+ *    --seconds S        シナリオの長さ
+ *    --scan-us US       シナリオのスキャン周期
+ *    --config PATH      tune_paramsなどで作成した設定データ
+ *    --events MODE      replay：再生して判定したイベント（既定）、logged：記録されたタッチ状態の変化
+ *    --short-ms MS      これより短いタッチをshortとして数える
+ *    --stuck-ms MS      これ以上続くタッチをstuckとして数える
+ *    --csv PATH         イベント単位のCSV（時刻[us],ポート,種別,ベロシティ,ラベル,遅延[us],継続時間[us]）の出力先
+ *    --json PATH        ポート単位の集計の出力先
+ */
+
+#include <string>
+#include <vector>
+#include "Options.h"
+#include "LogReader.h"
+#include "MPR121_Config.h"
+#include "Timeline.h"
+#include "TraceFile.h"
+
+//*****************************************************************************************************************************
+// 設定
+struct Options {
+  std::string input;
+  std::string scenario;
+  double seconds = 60;
+  uint32_t scanPeriod = 2000;
+  std::string config;
+  std::string events = "replay";
+  double shortMs = 30;
+  double stuckMs = 5000;
+  std::string csv;
+  std::string json;
+};
+
+//*****************************************************************************************************************************
+// 判定したイベントをタイムラインに記録する
+class TimelineSink : public MPR121EventSink {
+public:
+  TimelineSink(Timeline& setTimeline)
+    : timeline(setTimeline) {}
+  void onEvent(const MPR121Event& event) override {
+    timeline.add(HostClock::micros64(), event.port, event.type, event.velocity);
+  }
+
+private:
+  Timeline& timeline;
+};
+
+//*****************************************************************************************************************************
+/**
+ * @brief コマンドライン引数を読み取る
+ */
+//*****************************************************************************************************************************
+static bool parseOptions(int argc, char** argv, Options& options) {
+  bool parsed = parseOptionPairs(argc, argv, [&](const std::string& key, const std::string& value) {
+    if (key == "--input") options.input = value;
+    else if (key == "--scenario") options.scenario = value;
+    else if (key == "--seconds") options.seconds = atof(value.c_str());
+    else if (key == "--scan-us") options.scanPeriod = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--config") options.config = value;
+    else if (key == "--events") options.events = value;
+    else if (key == "--short-ms") options.shortMs = atof(value.c_str());
+    else if (key == "--stuck-ms") options.stuckMs = atof(value.c_str());
+    else if (key == "--csv") options.csv = value;
+    else if (key == "--json") options.json = value;
+    else return false;
+    return true;
+  });
+  if (!parsed) return false;
+  if (options.events != "replay" && options.events != "logged") {
+    fprintf(stderr, "unknown events mode: %s\n", options.events.c_str());
+    return false;
+  }
+  return true;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 記録データを拡張子に応じて読み込む
+ */
+//*****************************************************************************************************************************
+static bool loadInput(const std::string& path, Trace& trace) {
+  auto endsWith = [&path](const char* suffix) {
+    size_t length = strlen(suffix);
+    return path.size() > length && path.compare(path.size() - length, length, suffix) == 0;
+  };
+
+  if (endsWith(".mlog")) {
+    LogReader reader;
+    return reader.open(path) && reader.readAll(trace) > 0;
+  }
+  if (endsWith(".mtrc")) {
+    TraceFile file;
+    if (!file.open(path)) return false;
+    trace = Trace();
+    trace.portMask = file.getPortMask();
+    for (const TraceRecord& record : file) {
+      trace.time.push_back(record.time);
+      trace.touch.push_back(record.touch);
+      trace.filtered.insert(trace.filtered.end(), record.filtered, record.filtered + Trace::maxPort);
+      if (file.getHasBaseline()) trace.baseline.insert(trace.baseline.end(), record.baseline, record.baseline + Trace::maxPort);
+    }
+    trace.buildLabels();
+    return trace.size() > 0;
+  }
+  return loadTraceCsv(path, trace);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief トレースを再生し、判定したイベントをタイムラインに記録する
+ */
+//*****************************************************************************************************************************
+static void replayEvents(const Trace& trace, const std::vector<uint8_t>& config, Timeline& timeline) {
+  HostClock::simulated = true;
+  static TwoWire noBus;
+  MPR121Manager manager(0x5A, trace.portMask, &noBus);
+  if (!config.empty()) manager.loadConfig(config.data(), config.size());
+  TimelineSink sink(timeline);
+  manager.setEventSink(&sink);
+
+  // イベントの時刻がスキャンの記録時刻になるよう、再生前に時刻を進める
+  for (size_t n = 0; n < trace.size(); n++) {
+    HostClock::now = trace.time[n];
+    manager.replay(trace.filteredAt(n), trace.baselineAt(n), n == 0);
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 記録されたタッチ状態の変化をイベントとしてタイムラインに記録する
+ */
+//*****************************************************************************************************************************
+static void loggedEvents(const Trace& trace, Timeline& timeline) {
+  uint16_t lastTouched = 0;
+  for (size_t n = 0; n < trace.size(); n++) {
+    uint16_t touched = trace.touch[n] & trace.portMask;
+    for (uint16_t changed = touched ^ lastTouched; changed; changed &= changed - 1) {
+      uint8_t port = __builtin_ctz(changed);
+      timeline.add(trace.time[n], port, ((touched >> port) & 1) ? MPR121Event::TOUCH : MPR121Event::RELEASE);
+    }
+    lastTouched = touched;
+  }
+}
+
+//*****************************************************************************************************************************
+// メイン処理
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) return 1;
+  if (options.input.empty() && options.scenario.empty()) options.scenario = "step";
+
+  // トレースの読み込み（またはシナリオから作成）
+  Trace trace;
+  if (!options.input.empty()) {
+    if (!loadInput(options.input, trace)) {
+      fprintf(stderr, "cannot load: %s\n", options.input.c_str());
+      return 1;
+    }
+  } else {
+    uint64_t duration = (uint64_t)(options.seconds * 1000000);
+    SignalGenerator generator = SignalGenerator::preset(options.scenario, duration);
+    trace = traceFromGenerator(generator, duration, options.scanPeriod);
+    trace.name = options.scenario;
+  }
+  if (trace.size() == 0) {
+    fprintf(stderr, "no scans\n");
+    return 1;
+  }
+
+  std::vector<uint8_t> config;
+  if (!options.config.empty()) {
+    FILE* file = fopen(options.config.c_str(), "rb");
+    config.resize(MPR121Manager::configSize);
+    if (file == nullptr || fread(config.data(), 1, config.size(), file) != config.size()) {
+      fprintf(stderr, "cannot load config: %s\n", options.config.c_str());
+      if (file != nullptr) fclose(file);
+      return 1;
+    }
+    fclose(file);
+  }
+
+  // タイムラインの作成と解析（記録されたタッチ状態をそのまま使う場合はラベルとの照合を行わない）
+  Timeline timeline;
+  timeline.shortTime = (uint64_t)(options.shortMs * 1000);
+  timeline.stuckTime = (uint64_t)(options.stuckMs * 1000);
+  if (options.events == "logged") {
+    loggedEvents(trace, timeline);
+    timeline.analyse(trace.time.back());
+  } else {
+    replayEvents(trace, config, timeline);
+    timeline.analyse(trace.labels, trace.time.back());
+  }
+
+  // 集計の表示
+  printf("%zu scans, %.1f s, %zu events (%s)\n", trace.size(), trace.duration() / 1e6, timeline.getEvents().size(),
+         options.events.c_str());
+  printf("port labels touch  miss false chat short stuck  touch p50/p99 [ms]  release p50/p99 [ms]\n");
+  auto row = [](const char* name, const PortSummary& summary) {
+    printf("%4s %6zu %5zu %5zu %5zu %4zu %5zu %5zu  %8.2f %8.2f  %9.2f %9.2f\n", name, summary.labels, summary.touches,
+           summary.missed, summary.falseTouches, summary.chatter, summary.shortTouches, summary.stuck,
+           TouchScore::percentile(summary.touchLatency.values, 50) / 1000.0,
+           TouchScore::percentile(summary.touchLatency.values, 99) / 1000.0,
+           TouchScore::percentile(summary.releaseLatency.values, 50) / 1000.0,
+           TouchScore::percentile(summary.releaseLatency.values, 99) / 1000.0);
+  };
+  for (uint8_t port = 0; port < 12; port++) {
+    const PortSummary& summary = timeline.getPort(port);
+    if (summary.labels == 0 && summary.touches == 0) continue;
+    char name[8];
+    snprintf(name, sizeof(name), "%u", port);
+    row(name, summary);
+  }
+  row("all", timeline.getTotal());
+
+  if (!options.csv.empty() && !timeline.writeCsv(options.csv)) {
+    fprintf(stderr, "cannot write: %s\n", options.csv.c_str());
+    return 1;
+  }
+  if (!options.json.empty() && !timeline.writeJson(options.json)) {
+    fprintf(stderr, "cannot write: %s\n", options.json.c_str());
+    return 1;
+  }
+  return 0;
+}
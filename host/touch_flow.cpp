@@ -0,0 +1,259 @@
+/**
+ * @file touch_flow
+ * @brief コルーチン（MPR121Manager::nextEvent）によるタッチ操作の判定例
+ * @details 合成信号のシナリオを再生し、ポートごとのコルーチンでタップ・長押し・ダブルタップを判定する。
+ *          判定はnextEvent()をco_awaitして上から順に書いたもので、isTouched()のポーリングは行わない。
+ *          同じ規則を正解ラベルに適用した件数と、再生中の動的確保の回数（co_awaitごとに発生しないことの確認）を表示する。
+ *          続けて、リリースを待っている間に再キャリブレーション・切断でタッチが解除された場合に、
+ *          コルーチンがRELEASEを受け取って再開されることを確認する（受け取れない場合は終了コード1）。
+ *
+ * @section ビルド（リポジトリのルートで実行、C++20が必要）
+ *    g++ -std=c++20 -O2 -I host -I . host/touch_flow.cpp MPR121_Control.cpp MPR121_Output.cpp -o touch_flow
+ *
+ * @section 使い方
+ *    ./touch_flow --scenario step --seconds 60
+ *    --scenario NAME    合成信号のシナリオ
+ *    --seconds S        シナリオの長さ
+ *    --scan-us US       スキャン周期
+ *    --long-ms MS       これ以上続くタッチを長押しとする
+ *    --double-ms MS     リリースからこの時間内に再びタッチした場合をダブルタップとする
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include "Options.h"
+#include "MPR121_Config.h"
+#include "SimBus.h"
+#include "Trace.h"
+
+#ifndef MPR121_COROUTINE
+#error "touch_flow requires C++20 coroutines (-std=c++20)"
+#endif
+
+// 動的確保の回数（再生中に増えないことを確認する）
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size) {
+  allocations++;
+  void* memory = malloc(size ? size : 1);
+  if (memory == nullptr) throw std::bad_alloc();
+  return memory;
+}
+
+void operator delete(void* memory) noexcept {
+  free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+  free(memory);
+}
+
+//*****************************************************************************************************************************
+// 設定
+struct Options {
+  std::string scenario = "step";
+  double seconds = 60;
+  uint32_t scanPeriod = 2000;
+  uint32_t longMs = 300;
+  uint32_t doubleMs = 500;
+};
+
+// 操作の件数
+struct GestureCount {
+  uint32_t taps = 0;
+  uint32_t longPresses = 0;
+  uint32_t doubleTaps = 0;
+};
+
+//*****************************************************************************************************************************
+/**
+ * @brief コマンドライン引数を読み取る
+ */
+//*****************************************************************************************************************************
+static bool parseOptions(int argc, char** argv, Options& options) {
+  return parseOptionPairs(argc, argv, [&](const std::string& key, const std::string& value) {
+    if (key == "--scenario") options.scenario = value;
+    else if (key == "--seconds") options.seconds = atof(value.c_str());
+    else if (key == "--scan-us") options.scanPeriod = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--long-ms") options.longMs = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--double-ms") options.doubleMs = strtoul(value.c_str(), nullptr, 10);
+    else return false;
+    return true;
+  });
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 1ポートのタップ・長押し・ダブルタップを判定するコルーチン
+ * @details タッチ → リリースの長さで長押しを判定し、短い場合は次のタッチまでの間隔でダブルタップかを判定する。
+ *          ダブルタップでなかった場合、そのタッチは次の操作の始まりとして扱う。
+ */
+//*****************************************************************************************************************************
+static MPR121Task watchGestures(MPR121Manager& manager, uint8_t port, uint32_t longTime, uint32_t doubleTime,
+                                GestureCount& count) {
+  MPR121Event event = co_await manager.nextEvent(port);
+  for (;;) {
+    if (event.type != MPR121Event::TOUCH) {
+      event = co_await manager.nextEvent(port);
+      continue;
+    }
+
+    MPR121Event release = co_await manager.nextEvent(port);
+    if (release.time - event.time >= longTime) {
+      count.longPresses++;
+      event = co_await manager.nextEvent(port);
+      continue;
+    }
+
+    // 短いタッチの後は、次のタッチまでの間隔で判定する
+    MPR121Event next = co_await manager.nextEvent(port);
+    if (next.type == MPR121Event::TOUCH && next.time - release.time <= doubleTime) {
+      count.doubleTaps++;
+      co_await manager.nextEvent(port);  // 2回目のリリース
+      event = co_await manager.nextEvent(port);
+    } else {
+      count.taps++;
+      event = next;
+    }
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief タッチを待ち、続くリリース（または取り消し）を受け取るコルーチン
+ * @param released 受け取ったイベントの格納先（typeがTOUCHのままの場合は未受信）
+ */
+//*****************************************************************************************************************************
+static MPR121Task waitRelease(MPR121Manager& manager, uint8_t port, MPR121Event& released) {
+  MPR121Event event = co_await manager.nextEvent(port);
+  while (event.type != MPR121Event::TOUCH) event = co_await manager.nextEvent(port);
+  released = event;
+  released = co_await manager.nextEvent(port);
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 模擬デバイスに接続したマネージャーでタッチを確定させ、リリース待ちの状態で解除の操作を行う
+ * @param interrupt タッチの解除を引き起こす操作（再キャリブレーション・切断）
+ * @return 解除の操作の後にRELEASEを受け取った場合true
+ */
+//*****************************************************************************************************************************
+template <class Interrupt>
+static bool releaseOnInterrupt(Interrupt interrupt) {
+  const uint8_t port = 0;
+  SimBus bus;
+  MPR121Mock mock;
+  bus.attach(&mock);
+  TwoWire wire(&bus);
+  MPR121Manager manager(mock.getAddress(), 0x0FFF, &wire);
+  manager.setStatusCheckInterval(5);
+  auto scan = [&](int count) {
+    for (int n = 0; n < count; n++) {
+      manager.update();
+      HostClock::advance(2000);
+    }
+  };
+
+  MPR121Event released = {};
+  released.type = MPR121Event::TOUCH;
+  waitRelease(manager, port, released);
+  mock.setLevel(port, 640);
+  scan(50);
+  bool waiting = manager.isTouched(port) && released.type == MPR121Event::TOUCH;
+
+  interrupt(bus, mock);
+  scan(50);
+  return waiting && !manager.isTouched(port) && released.type == MPR121Event::RELEASE;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief リリースを待っている間にタッチが解除された場合の確認（再キャリブレーションと切断）
+ * @return 両方でRELEASEを受け取った場合true
+ */
+//*****************************************************************************************************************************
+static bool checkInterruptedTouch() {
+  // 再キャリブレーション：タッチ中に別のポートが範囲外となり、基板の判定をやり直す
+  bool resettled = releaseOnInterrupt([](SimBus&, MPR121Mock& mock) { mock.setOutOfRange(0x0020); });
+
+  // 切断：模擬デバイスをバスから外し、update()の失敗で未接続とする
+  bool disconnected = releaseOnInterrupt([](SimBus& bus, MPR121Mock& mock) { bus.setConnected(mock.getAddress(), false); });
+
+  printf("release while waiting: resettle %s, disconnect %s\n", resettled ? "ok" : "NG", disconnected ? "ok" : "NG");
+  return resettled && disconnected;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 正解ラベルに同じ規則を適用して件数を求める（最後の短いタッチは後続がないため数えない）
+ */
+//*****************************************************************************************************************************
+static GestureCount countLabels(const std::vector<TouchLabel>& labels, uint8_t port, uint64_t longTime, uint64_t doubleTime) {
+  std::vector<TouchLabel> touches;
+  for (const TouchLabel& label : labels) {
+    if (label.port == port) touches.push_back(label);
+  }
+
+  GestureCount count;
+  for (size_t n = 0; n < touches.size(); n++) {
+    if (touches[n].end - touches[n].start >= longTime) {
+      count.longPresses++;
+    } else if (n + 1 < touches.size() && touches[n + 1].start - touches[n].end <= doubleTime) {
+      count.doubleTaps++;
+      n++;
+    } else if (n + 1 < touches.size()) {
+      count.taps++;
+    }
+  }
+  return count;
+}
+
+//*****************************************************************************************************************************
+// メイン処理
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) return 1;
+
+  uint64_t duration = (uint64_t)(options.seconds * 1000000);
+  SignalGenerator generator = SignalGenerator::preset(options.scenario, duration);
+  Trace trace = traceFromGenerator(generator, duration, options.scanPeriod);
+  if (trace.size() == 0) {
+    fprintf(stderr, "no scans\n");
+    return 1;
+  }
+
+  HostClock::simulated = true;
+  static TwoWire noBus;
+  MPR121Manager manager(0x5A, trace.portMask, &noBus);
+
+  // ポートごとに判定用のコルーチンを開始する（フレームの確保はここで1回のみ）
+  GestureCount counts[12];
+  for (uint8_t port = 0; port < 12; port++) {
+    if ((trace.portMask >> port) & 1) {
+      watchGestures(manager, port, options.longMs * 1000, options.doubleMs * 1000, counts[port]);
+    }
+  }
+
+  // 再生（イベントの発生時刻がスキャンの記録時刻になるよう、再生前に時刻を進める）
+  uint64_t before = allocations;
+  for (size_t n = 0; n < trace.size(); n++) {
+    HostClock::now = trace.time[n];
+    manager.replay(trace.filteredAt(n), trace.baselineAt(n), n == 0);
+  }
+  uint64_t replayAllocations = allocations - before;
+
+  printf("%zu scans, %.1f s, %zu labels\n", trace.size(), trace.duration() / 1e6, trace.labels.size());
+  printf("port   tap  long double   (labels: tap  long double)\n");
+  for (uint8_t port = 0; port < 12; port++) {
+    if (!((trace.portMask >> port) & 1)) continue;
+    GestureCount expected = countLabels(trace.labels, port, options.longMs * 1000ULL, options.doubleMs * 1000ULL);
+    printf("%4u %5u %5u %6u   %13u %5u %6u\n", port, counts[port].taps, counts[port].longPresses, counts[port].doubleTaps,
+           expected.taps, expected.longPresses, expected.doubleTaps);
+  }
+  printf("allocations during replay: %llu\n", (unsigned long long)replayAllocations);
+
+  return checkInterruptedTouch() ? 0 : 1;
+}
@@ -0,0 +1,303 @@
+/**
+ * @file touch_gateway
+ * @brief Linuxのシングルボードコンピューター用のタッチ状態配信ツール
+ * @details i2c-dev（/dev/i2c-N）に接続した基板を一定周期で更新し、更新結果を共有メモリのリングバッファ（SnapshotRing.h）に
+ *          書き込む。同じ機器上の他のプロセスは共有メモリを読むだけでタッチ状態と計測値を取得できる。
+ *          printStatus()の出力をパイプで受けて解析する方法の置き換えとして使用する。
+ *
+ * @section ビルド（リポジトリのルートで実行）
+ *    g++ -std=c++17 -O2 -I host -I . host/touch_gateway.cpp MPR121_Control.cpp MPR121_Output.cpp -o touch_gateway -lrt
+ *
+ * @section 使い方
+ *    ./touch_gateway --bus /dev/i2c-1 --address 0x5A,0x5B --shm /mpr121      基板を更新して共有メモリに配信
+ *    ./touch_gateway --standin 1 --address 0x5A,0x5B --seconds 10             i2c-devの代わりに模擬MPR121で動作確認
+ *    ./touch_gateway --watch /mpr121                                          共有メモリを読んでタッチ／リリースを表示
+ *    ./touch_gateway --address 0x5A --idle-us 100000 --irq /dev/gpiochip0:17  タッチがない間は周期を落とし、IRQで即時に更新
+ *    ./touch_gateway --standin 1 --idle-us 30000 --seconds 10 --check 1        アイドル周期でも常時アクティブ周期と同じ件数を検出するか確認
+ *    --bus PATH         i2c-devのデバイスファイル
+ *    --standin 1        i2c-devの代わりに模擬MPR121（合成信号のstepシナリオ、基板ごとに1ポート）を使用
+ *    --address LIST     基板のI2Cアドレス
+ *    --shm NAME         共有メモリ名
+ *    --slots N          リングバッファのレコード数
+ *    --period-us US     更新周期（タッチ中・IRQ後のアクティブ周期）
+ *    --idle-us US       タッチ中・判定途中のポートがない間の更新周期（0で常に--period-us）
+ *                       IRQなしでは、最短のタッチ時間から確定までの時間（(touchJuge + 1) × --period-us）を引いた値より短くすること
+ *    --hold-ms MS       IRQ後にアクティブ周期を続ける時間
+ *    --irq CHIP:LINE    MPR121のIRQ端子を接続したGPIO行（スタンドインでは正解ラベルの変化時に起床を模擬）
+ *    --seconds S        実行時間（0で停止するまで）
+ *    --batch 1          全基板の読み出しを1回のioctl（I2C_RDWR）にまとめる（オーバーサンプリングは行わない）
+ *    --watch NAME       読み出し側として動作する
+ *    --check 1          スタンドインを--idle-us 0と指定の周期で順に実行し、タッチ／リリースの件数が一致しない場合は終了コード1を返す
+ *                       （末尾の1秒はタッチを発生させない）
+ */
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Options.h"
+#include "LinuxI2C.h"
+#include "ScanLoop.h"
+#include "SignalGen.h"
+#include "SnapshotRing.h"
+
+//*****************************************************************************************************************************
+// 設定
+struct Options {
+  std::string bus = "/dev/i2c-1";
+  bool standin = false;
+  std::vector<uint8_t> address = { 0x5A };
+  std::string shm = "/mpr121";
+  uint32_t slots = 4096;
+  uint32_t period = 5000;
+  uint32_t idlePeriod = 0;
+  uint32_t holdMs = 500;
+  std::string irq;
+  double seconds = 0;
+  bool batch = false;
+  std::string watch;
+  bool check = false;
+};
+
+// 更新中に検出したタッチ状態の変化の件数
+struct EventCount {
+  uint64_t touches = 0;
+  uint64_t releases = 0;
+};
+
+//*****************************************************************************************************************************
+/**
+ * @brief コマンドライン引数を読み取る
+ */
+//*****************************************************************************************************************************
+static bool parseOptions(int argc, char** argv, Options& options) {
+  return parseOptionPairs(argc, argv, [&](const std::string& key, const std::string& value) {
+    if (key == "--bus") options.bus = value;
+    else if (key == "--standin") options.standin = atoi(value.c_str()) != 0;
+    else if (key == "--address") {
+      options.address.clear();
+      for (const std::string& item : split(value)) options.address.push_back(strtoul(item.c_str(), nullptr, 0));
+    } else if (key == "--shm") options.shm = value;
+    else if (key == "--slots") options.slots = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--period-us") options.period = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--idle-us") options.idlePeriod = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--hold-ms") options.holdMs = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--irq") options.irq = value;
+    else if (key == "--seconds") options.seconds = atof(value.c_str());
+    else if (key == "--batch") options.batch = atoi(value.c_str()) != 0;
+    else if (key == "--watch") options.watch = value;
+    else if (key == "--check") options.check = atoi(value.c_str()) != 0;
+    else return false;
+    return true;
+  });
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 共有メモリを読み、基板ごとのタッチ状態の変化を表示する
+ */
+//*****************************************************************************************************************************
+static int watch(const Options& options) {
+  SnapshotReader reader;
+  if (!reader.open(options.watch)) {
+    fprintf(stderr, "cannot open shared memory: %s\n", options.watch.c_str());
+    return 1;
+  }
+
+  // 開いた時点以降のレコードから読む
+  uint64_t cursor = reader.getPublished();
+  uint64_t records = 0, skipped = 0;
+  uint16_t lastTouched[256] = {};
+  auto start = std::chrono::steady_clock::now();
+  Snapshot snapshot;
+  while (options.seconds <= 0
+         || std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < options.seconds) {
+    uint64_t expected = cursor;
+    if (!reader.next(cursor, snapshot)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    skipped += snapshot.sequence - expected;
+    records++;
+
+    uint16_t& last = lastTouched[snapshot.board];
+    for (uint16_t changed = snapshot.touched ^ last; changed; changed &= changed - 1) {
+      uint8_t port = __builtin_ctz(changed);
+      printf("%llu board %u (0x%02X) port %u %s\n", (unsigned long long)snapshot.time, snapshot.board, snapshot.address,
+             port, ((snapshot.touched >> port) & 1) ? "touch" : "release");
+    }
+    last = snapshot.touched;
+  }
+  printf("%llu records read, %llu skipped (overwritten before read)\n", (unsigned long long)records,
+         (unsigned long long)skipped);
+  return 0;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 基板を更新して共有メモリに配信する
+ * @param count 検出したタッチ／リリースの件数の格納先
+ * @return 終了コード
+ */
+//*****************************************************************************************************************************
+static int serve(const Options& options, EventCount& count) {
+  const uint64_t origin = HostClock::micros64();  // 実行開始時刻（スタンドインの合成信号の基準）
+
+  // バスを開く（スタンドインの場合は模擬MPR121を接続）
+  std::unique_ptr<LinuxI2CBus> bus;
+  std::vector<std::unique_ptr<MPR121Mock>> mocks;
+  std::vector<uint64_t> irqEdges;
+  if (options.standin) {
+    I2CDevStandIn* standin = new I2CDevStandIn();
+    bus.reset(standin);
+    // 基板ごとに1ポートのみタッチさせる（Sourceの計算量はタッチ数に比例するため、長さも実行時間に合わせる）
+    // 合成信号の時刻は実行開始からの経過時間とする。件数の確認では末尾にタッチのない1秒を残す
+    uint64_t duration = (uint64_t)((options.seconds > 0 ? options.seconds : 600) * 1000000);
+    if (options.check) duration -= 1000000;
+    for (size_t d = 0; d < options.address.size(); d++) {
+      auto generator = std::make_shared<SignalGenerator>(SignalGenerator::preset("step", duration, 1 << (d % 12), d + 1));
+      for (const TouchLabel& label : generator->getLabels()) {
+        irqEdges.push_back(origin + label.start);
+        irqEdges.push_back(origin + label.end);
+      }
+      mocks.emplace_back(new MPR121Mock(options.address[d]));
+      mocks.back()->setSource([generator, origin](uint8_t electrode, uint64_t time) {
+        return (*generator)(electrode, time - origin);
+      });
+      standin->attach(mocks.back().get());
+    }
+  } else {
+    bus.reset(new LinuxI2CBus());
+    if (!bus->open(options.bus)) {
+      fprintf(stderr, "cannot open i2c bus: %s\n", options.bus.c_str());
+      return 1;
+    }
+  }
+  TwoWire wire(bus.get());
+
+  SnapshotPublisher publisher;
+  if (!publisher.create(options.shm, options.slots)) {
+    fprintf(stderr, "cannot create shared memory: %s\n", options.shm.c_str());
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<MPR121Manager>> managers;
+  MPR121BatchUpdate batch(*bus);
+  for (uint8_t address : options.address) {
+    managers.emplace_back(new MPR121Manager(address, 0x0FFF, &wire));
+    batch.add(*managers.back());
+  }
+  const uint64_t setupIoctls = bus->getStats().ioctls;
+
+  // 全基板を更新して配信し、タッチ中・判定途中のポートがある間はアクティブ周期を続ける
+  // （IRQがない場合、タッチの確定に必要な連続判定をアイドル周期で待つと検出できないため）
+  std::vector<uint16_t> lastTouched(managers.size(), 0);
+  ScanLoop loop(
+    [&]() {
+      if (options.batch) batch.update();
+      for (size_t d = 0; d < managers.size(); d++) {
+        if (!options.batch) managers[d]->update();
+        publisher.publish(HostClock::micros64(), d, managers[d]->getAddress(), *managers[d]);
+
+        uint16_t touched = managers[d]->getTouchedPorts();
+        for (uint16_t changed = touched ^ lastTouched[d]; changed; changed &= changed - 1) {
+          if ((touched >> __builtin_ctz(changed)) & 1) count.touches++;
+          else count.releases++;
+        }
+        lastTouched[d] = touched;
+      }
+    },
+    [&]() {
+      for (auto& manager : managers) {
+        if (manager->getDetectingPorts() != 0) return true;
+      }
+      return false;
+    });
+  if (!loop.open(options.period, options.idlePeriod, options.holdMs * 1000)) {
+    fprintf(stderr, "cannot create timer\n");
+    return 1;
+  }
+
+  // IRQ端子（スタンドインでは、正解ラベルの開始・終了時刻にIRQの代わりにsignal()で起床させる）
+  std::atomic<bool> running(true);
+  std::thread irqStandIn;
+  if (!options.irq.empty() && !options.standin) {
+    size_t colon = options.irq.rfind(':');
+    if (colon == std::string::npos
+        || !loop.attachIrq(options.irq.substr(0, colon), strtoul(options.irq.c_str() + colon + 1, nullptr, 10))) {
+      fprintf(stderr, "cannot request gpio line: %s\n", options.irq.c_str());
+      return 1;
+    }
+  } else if (!options.irq.empty()) {
+    std::sort(irqEdges.begin(), irqEdges.end());
+    irqStandIn = std::thread([&]() {
+      for (uint64_t edge : irqEdges) {
+        while (running && HostClock::micros64() < edge) {
+          uint64_t wait = std::min<uint64_t>(edge - HostClock::micros64(), 100000);
+          std::this_thread::sleep_for(std::chrono::microseconds(wait));
+        }
+        if (!running) break;
+        loop.signal();
+      }
+    });
+  }
+
+  rusage before;
+  getrusage(RUSAGE_SELF, &before);
+  loop.run((uint64_t)(options.seconds * 1000000));
+  running = false;
+  if (irqStandIn.joinable()) irqStandIn.join();
+  rusage after;
+  getrusage(RUSAGE_SELF, &after);
+  auto cpu = [](const rusage& usage) {
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+  };
+  const ScanLoop::Stats& loopStats = loop.getStats();
+  uint64_t scans = loopStats.scans;
+
+  // 起動時の設定を除いた更新中のioctl回数
+  const LinuxI2CBus::Stats& stats = bus->getStats();
+  uint64_t ioctls = stats.ioctls - setupIoctls;
+  printf("%llu scans x %zu boards, %llu ioctls (%.2f per scan), %llu nacks, %llu errors\n", (unsigned long long)scans,
+         managers.size(), (unsigned long long)ioctls, scans ? (double)ioctls / scans : 0.0,
+         (unsigned long long)stats.nacks, (unsigned long long)stats.errors);
+  if (options.batch) printf("batch fallbacks: %llu\n", (unsigned long long)batch.getStats().fallbacks);
+  printf("wakeups %llu (active scans %llu, signals %llu, irqs %llu), cpu %.3f s\n", (unsigned long long)loopStats.wakeups,
+         (unsigned long long)loopStats.activeScans, (unsigned long long)loopStats.signals,
+         (unsigned long long)loopStats.irqs, cpu(after) - cpu(before));
+  printf("events: touches %llu, releases %llu\n", (unsigned long long)count.touches, (unsigned long long)count.releases);
+  return 0;
+}
+
+//*****************************************************************************************************************************
+// メイン処理
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) return 1;
+  if (!options.watch.empty()) return watch(options);
+
+  EventCount count;
+  if (!options.check) return serve(options, count);
+
+  // スタンドインで常時アクティブ周期とした場合と件数を比較
+  if (!options.standin || options.seconds <= 1) {
+    fprintf(stderr, "--check requires --standin 1 and --seconds longer than 1\n");
+    return 1;
+  }
+  Options active = options;
+  active.idlePeriod = 0;
+  EventCount expected;
+  int result = serve(active, expected);
+  if (result != 0) return result;
+  result = serve(options, count);
+  if (result != 0) return result;
+  bool same = count.touches == expected.touches && count.releases == expected.releases;
+  printf("check: idle-us %u %llu/%llu touch/release, idle-us 0 %llu/%llu -> %s\n", options.idlePeriod,
+         (unsigned long long)count.touches, (unsigned long long)count.releases, (unsigned long long)expected.touches,
+         (unsigned long long)expected.releases, same ? "ok" : "NG");
+  return same ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+/**
+ * @file trace_replay
+ * @brief トレースファイルの作成と再生速度の確認
+ * @details CSVトレースや記録ファイル（.mlog）を固定長レコードのトレースファイル（.mtrc）に変換し、
+ *          メモリマップしたレコードをそのまま再生して、読み出しと判定処理それぞれの時間を表示する。
+ *
+ * @section ビルド（リポジトリのルートで実行）
+ *    g++ -std=c++17 -O2 -I host -I . host/trace_replay.cpp MPR121_Control.cpp MPR121_Output.cpp -o trace_replay
+ *
+ * @section 使い方
+ *    ./trace_replay convert touch.mlog touch.mtrc     .csv／.mlogをトレースファイルに変換
+ *    ./trace_replay direct touch.mtrc                 レコードをMPR121Manager::replay()に直接渡して再生
+ *    ./trace_replay mock touch.mtrc                   レコードを模擬MPR121の計測値としてupdate()で再生（I2Cの模擬を含む）
+ */
+
+#include <chrono>
+#include <string>
+#include "LogReader.h"
+#include "MPR121_Config.h"
+#include "SimBus.h"
+#include "TraceFile.h"
+
+//*****************************************************************************************************************************
+/**
+ * @brief 経過時間[s]を返す
+ */
+//*****************************************************************************************************************************
+static double since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief .csvまたは.mlogをトレースファイルに変換する
+ */
+//*****************************************************************************************************************************
+static int convert(const std::string& input, const std::string& output) {
+  auto start = std::chrono::steady_clock::now();
+  Trace trace;
+  bool loaded = false;
+  if (input.size() > 5 && input.compare(input.size() - 5, 5, ".mlog") == 0) {
+    LogReader reader;
+    loaded = reader.open(input) && reader.readAll(trace) > 0;
+  } else {
+    loaded = loadTraceCsv(input, trace);
+  }
+  if (!loaded) {
+    fprintf(stderr, "cannot load: %s\n", input.c_str());
+    return 1;
+  }
+  double parse = since(start);
+
+  if (!writeTraceFile(output, trace)) {
+    fprintf(stderr, "cannot write: %s\n", output.c_str());
+    return 1;
+  }
+  printf("%zu scans: parsed %s in %.3f s (%.1f M scans/s)\n", trace.size(), input.c_str(), parse,
+         trace.size() / parse / 1e6);
+  return 0;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief レコードをMPR121Manager::replay()に直接渡して再生する
+ */
+//*****************************************************************************************************************************
+static int replayDirect(const TraceFile& file) {
+  HostClock::simulated = true;
+  static TwoWire noBus;
+  MPR121Manager manager(0x5A, file.getPortMask(), &noBus);
+
+  // 読み出しのみの時間（全レコードの計測値に触れる）
+  auto start = std::chrono::steady_clock::now();
+  uint64_t sum = 0;
+  for (const TraceRecord& record : file) {
+    for (uint16_t value : record.filtered) sum += value;
+  }
+  double read = since(start);
+
+  // 再生
+  start = std::chrono::steady_clock::now();
+  bool baseline = file.getHasBaseline();
+  size_t events = 0;
+  uint16_t lastTouched = 0;
+  for (const TraceRecord* record = file.begin(); record != file.end(); record++) {
+    manager.replay(record->filtered, baseline ? record->baseline : nullptr, record == file.begin());
+    uint16_t touched = manager.getTouchedPorts();
+    for (uint16_t changed = touched ^ lastTouched; changed; changed &= changed - 1) events++;
+    lastTouched = touched;
+  }
+  double replay = since(start);
+
+  size_t count = file.getCount();
+  printf("%zu scans (checksum %llu)\n", count, (unsigned long long)sum);
+  printf("read   : %.4f s (%.1f M scans/s)\n", read, count / read / 1e6);
+  printf("replay : %.4f s (%.1f M scans/s), %zu events\n", replay, count / replay / 1e6, events);
+  return 0;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief レコードを模擬MPR121の計測値として、記録時刻どおりにupdate()を呼び出して再生する
+ */
+//*****************************************************************************************************************************
+static int replayMock(const TraceFile& file) {
+  if (file.getCount() == 0) return 1;
+  HostClock::simulated = true;
+  HostClock::now = 0;
+
+  SimBus bus;
+  TwoWire wire(&bus);
+  MPR121Mock mock;
+  bus.attach(&mock);
+
+  // 模擬MPR121の起動後にトレースの先頭が来るようにずらす
+  const uint64_t origin = 200000;
+  const uint64_t offset = origin - file.begin()->time;
+  mock.setSource(traceSource(file, offset));
+  MPR121Manager manager(0x5A, file.getPortMask(), &wire);
+
+  auto start = std::chrono::steady_clock::now();
+  size_t events = 0;
+  uint16_t lastTouched = 0;
+  for (const TraceRecord& record : file) {
+    if (HostClock::now < record.time + offset) HostClock::now = record.time + offset;
+    manager.update();
+    uint16_t touched = manager.getTouchedPorts();
+    for (uint16_t changed = touched ^ lastTouched; changed; changed &= changed - 1) events++;
+    lastTouched = touched;
+  }
+  double replay = since(start);
+
+  printf("%zu scans through update(): %.4f s (%.1f M scans/s), %zu events\n", file.getCount(), replay,
+         file.getCount() / replay / 1e6, events);
+  return 0;
+}
+
+//*****************************************************************************************************************************
+// メイン処理
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: trace_replay convert|direct|mock ...\n");
+    return 1;
+  }
+  std::string command = argv[1];
+  if (command == "convert") {
+    if (argc == 4) return convert(argv[2], argv[3]);
+    fprintf(stderr, "usage: trace_replay convert input output.mtrc\n");
+    return 1;
+  }
+
+  TraceFile file;
+  if (!file.open(argv[2])) {
+    fprintf(stderr, "cannot open trace file: %s\n", argv[2]);
+    return 1;
+  }
+  if (command == "direct") return replayDirect(file);
+  if (command == "mock") return replayMock(file);
+
+  fprintf(stderr, "unknown command: %s\n", command.c_str());
+  return 1;
+}
@@ -0,0 +1,326 @@
+/**
+ * @file tune_params
+ * @brief 記録データによる判定パラメータの自動探索
+ * @details 正解ラベル付きのトレースをMPR121Manager::replay()で再生し、alpha・touchMargin・releaseMargin・
+ *          touchJuge・releaseJugeの組み合わせを全コアで並列に評価する。誤検出の許容量を満たす中から
+ *          タッチ検出遅延が最小のものを選び、loadConfig()で読み込める設定データとして出力する。
+ *          許容量を満たす組み合わせがない場合は、設定データを出力せずに終了コード1を返す（--allow-infeasible 1で出力）。
+ *
+ * @section ビルド（リポジトリのルートで実行）
+ *    g++ -std=c++17 -O2 -pthread -I host -I . host/tune_params.cpp MPR121_Control.cpp MPR121_Output.cpp -o tune_params
+ *
+ * @section 使い方
+ *    ./tune_params --trace a.csv,b.csv --false-budget 0.5 --out config.bin
+ *    --trace LIST           CSV形式のトレース（Trace.h参照）
+ *    --scenario LIST        トレースの代わりに合成信号のシナリオを使用（省略時かつ--traceなしはstep,drift,hum）
+ *                           slow・shallow・waterは既定の探索範囲では許容量を満たせないため、範囲や許容量と合わせて指定する
+ *    --seconds S            シナリオの長さ
+ *    --scan-us US           シナリオのスキャン周期
+ *    --alpha LIST           平滑化係数
+ *    --touch-margin LIST    タッチマージン
+ *    --release-margin LIST  リリースマージン
+ *    --touch-juge LIST      タッチ判定の回数
+ *    --release-juge LIST    リリース判定の回数
+ *    --false-budget N       許容する誤検出（チャタリング含む）[回/分]（省略時0.5）
+ *    --miss-budget N        許容する見逃しの割合[%]（省略時1）
+ *    --allow-infeasible 1   許容量を満たす組み合わせがない場合も、最も近いものを出力する
+ *    --threads N            並列数（省略時はコア数）
+ *    --top N                表示する上位の件数
+ *    --out PATH             最良の設定データ（バイナリ）の出力先
+ */
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Options.h"
+#include "Scorer.h"
+#include "Trace.h"
+
+//*****************************************************************************************************************************
+// 設定
+struct Options {
+  std::vector<std::string> trace;
+  std::vector<std::string> scenario;
+  double seconds = 20;
+  uint32_t scanPeriod = 2000;
+  std::vector<std::string> alpha = { "0.2", "0.4", "0.6", "0.8", "1.0" };
+  std::vector<std::string> touchMargin = { "20", "30", "40" };
+  std::vector<std::string> releaseMargin = { "10", "20" };
+  std::vector<std::string> touchJuge = { "3", "5", "10", "15" };
+  std::vector<std::string> releaseJuge = { "3", "5", "10", "15" };
+  double falseBudget = 0.5;
+  double missBudget = 1;
+  bool allowInfeasible = false;
+  unsigned threads = 0;
+  size_t top = 10;
+  std::string out;
+};
+
+// 探索するパラメータの組み合わせ
+struct Candidate {
+  float alpha;
+  uint8_t touchMargin;
+  uint8_t releaseMargin;
+  uint8_t touchJuge;
+  uint8_t releaseJuge;
+};
+
+// 評価結果
+struct Result {
+  Candidate candidate;
+  size_t labels = 0;        // 正解のタッチ数
+  size_t detected = 0;      // 検出数
+  size_t falseTouches = 0;  // 誤検出数（チャタリング含む）
+  double touchMean = 0;     // タッチ検出遅延の平均[ms]
+  double touchP90 = 0;      // タッチ検出遅延の90%値[ms]
+  double releaseMean = 0;   // リリース検出遅延の平均[ms]
+  bool feasible = false;    // 誤検出・見逃しの許容量を満たすか
+};
+
+//*****************************************************************************************************************************
+/**
+ * @brief コマンドライン引数を読み取る
+ */
+//*****************************************************************************************************************************
+static bool parseOptions(int argc, char** argv, Options& options) {
+  return parseOptionPairs(argc, argv, [&](const std::string& key, const std::string& value) {
+    if (key == "--trace") options.trace = split(value);
+    else if (key == "--scenario") options.scenario = split(value);
+    else if (key == "--seconds") options.seconds = atof(value.c_str());
+    else if (key == "--scan-us") options.scanPeriod = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--alpha") options.alpha = split(value);
+    else if (key == "--touch-margin") options.touchMargin = split(value);
+    else if (key == "--release-margin") options.releaseMargin = split(value);
+    else if (key == "--touch-juge") options.touchJuge = split(value);
+    else if (key == "--release-juge") options.releaseJuge = split(value);
+    else if (key == "--false-budget") options.falseBudget = atof(value.c_str());
+    else if (key == "--miss-budget") options.missBudget = atof(value.c_str());
+    else if (key == "--allow-infeasible") options.allowInfeasible = atoi(value.c_str()) != 0;
+    else if (key == "--threads") options.threads = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--top") options.top = strtoul(value.c_str(), nullptr, 10);
+    else if (key == "--out") options.out = value;
+    else return false;
+    return true;
+  });
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 1つのパラメータの組み合わせを設定する
+ */
+//*****************************************************************************************************************************
+static void applyCandidate(MPR121Manager& manager, const Candidate& candidate) {
+  manager.setAlpha(candidate.alpha);
+  for (uint8_t port = 0; port < 12; port++) {
+    manager.setTouchMargin(port, candidate.touchMargin);
+    manager.setReleaseMargin(port, candidate.releaseMargin);
+    manager.setTouchJugeCount(port, candidate.touchJuge);
+    manager.setReleaseJugeCount(port, candidate.releaseJuge);
+  }
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 全トレースを再生して1つのパラメータの組み合わせを評価する
+ * @param manager 再生に使用するMPR121Manager（スレッドごとに1つ）
+ * @param candidate 評価するパラメータ
+ * @param traces 再生するトレース
+ * @param minutes 全トレースの合計時間[分]
+ */
+//*****************************************************************************************************************************
+static Result evaluate(MPR121Manager& manager, const Candidate& candidate, const std::vector<Trace>& traces,
+                       double minutes, const Options& options) {
+  Result result;
+  result.candidate = candidate;
+  std::vector<uint64_t> touchLatency;
+  std::vector<uint64_t> releaseLatency;
+  std::vector<TouchTransition> transitions;
+
+  for (const Trace& trace : traces) {
+    if (trace.size() == 0) continue;
+
+    // 先頭のスキャンで判定状態を初期化してから再生
+    applyCandidate(manager, candidate);
+    manager.replay(trace.filteredAt(0), trace.baselineAt(0), true);
+
+    transitions.clear();
+    uint16_t lastTouched = 0;
+    for (size_t n = 1; n < trace.size(); n++) {
+      manager.replay(trace.filteredAt(n), trace.baselineAt(n));
+      for (uint8_t port = 0; port < Trace::maxPort; port++) {
+        bool touched = manager.isTouched(port);
+        if (touched != (bool)((lastTouched >> port) & 1)) {
+          lastTouched ^= (1 << port);
+          transitions.push_back({ trace.time[n], port, touched });
+        }
+      }
+    }
+
+    TouchScore score = scoreTransitions(trace.labels, transitions);
+    result.labels += score.labels;
+    result.detected += score.detected;
+    result.falseTouches += score.falseTouches + score.chatter;
+    touchLatency.insert(touchLatency.end(), score.touchLatency.begin(), score.touchLatency.end());
+    releaseLatency.insert(releaseLatency.end(), score.releaseLatency.begin(), score.releaseLatency.end());
+  }
+
+  // 遅延の集計[ms]
+  double sum = 0;
+  for (uint64_t latency : touchLatency) sum += latency;
+  result.touchMean = touchLatency.empty() ? 0 : sum / touchLatency.size() / 1000.0;
+  result.touchP90 = TouchScore::percentile(touchLatency, 90) / 1000.0;
+  sum = 0;
+  for (uint64_t latency : releaseLatency) sum += latency;
+  result.releaseMean = releaseLatency.empty() ? 0 : sum / releaseLatency.size() / 1000.0;
+
+  // 許容量の判定
+  double missed = result.labels ? 100.0 * (result.labels - result.detected) / result.labels : 0;
+  result.feasible = (result.falseTouches / minutes <= options.falseBudget) && (missed <= options.missBudget);
+  return result;
+}
+
+//*****************************************************************************************************************************
+/**
+ * @brief 評価結果の優劣を比較する（許容量を満たすもの、タッチ遅延、リリース遅延の順）
+ */
+//*****************************************************************************************************************************
+static bool better(const Result& a, const Result& b) {
+  if (a.feasible != b.feasible) return a.feasible;
+  if (!a.feasible) {
+    // どちらも満たさない場合は許容量に近いものを優先
+    if (a.falseTouches != b.falseTouches) return a.falseTouches < b.falseTouches;
+    if (a.detected != b.detected) return a.detected > b.detected;
+  }
+  if (a.touchMean != b.touchMean) return a.touchMean < b.touchMean;
+  return a.releaseMean < b.releaseMean;
+}
+
+//*****************************************************************************************************************************
+// メイン処理
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) return 1;
+  if (options.trace.empty() && options.scenario.empty()) options.scenario = { "step", "drift", "hum" };
+
+  // MPR121Managerの起動待機を仮想時刻で済ませる
+  HostClock::simulated = true;
+
+  // トレースの読み込み（またはシナリオから作成）
+  std::vector<Trace> traces;
+  for (const std::string& path : options.trace) {
+    Trace trace;
+    if (!loadTraceCsv(path, trace)) {
+      fprintf(stderr, "cannot load trace: %s\n", path.c_str());
+      return 1;
+    }
+    traces.push_back(std::move(trace));
+  }
+  for (const std::string& scenario : options.scenario) {
+    uint64_t duration = (uint64_t)(options.seconds * 1000000);
+    SignalGenerator generator = SignalGenerator::preset(scenario, duration);
+    traces.push_back(traceFromGenerator(generator, duration, options.scanPeriod));
+    traces.back().name = scenario;
+  }
+
+  size_t scans = 0;
+  uint64_t duration = 0;
+  uint16_t portMask = 0;
+  for (const Trace& trace : traces) {
+    scans += trace.size();
+    duration += trace.duration();
+    portMask |= trace.portMask;
+  }
+  double minutes = duration / 60000000.0;
+  if (minutes <= 0) {
+    fprintf(stderr, "no scans to replay\n");
+    return 1;
+  }
+
+  // 探索するパラメータの組み合わせ（touchMargin > releaseMarginのもののみ）
+  std::vector<Candidate> candidates;
+  for (const std::string& alpha : options.alpha) {
+    for (const std::string& tm : options.touchMargin) {
+      for (const std::string& rm : options.releaseMargin) {
+        for (const std::string& tj : options.touchJuge) {
+          for (const std::string& rj : options.releaseJuge) {
+            Candidate candidate = { (float)atof(alpha.c_str()), (uint8_t)atoi(tm.c_str()), (uint8_t)atoi(rm.c_str()),
+                                    (uint8_t)atoi(tj.c_str()), (uint8_t)atoi(rj.c_str()) };
+            if (candidate.releaseMargin >= candidate.touchMargin) continue;
+            candidates.push_back(candidate);
+          }
+        }
+      }
+    }
+  }
+
+  // スレッドごとに再生用のMPR121Managerを用意（I2Cバスは接続しない）
+  unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+  static TwoWire noBus;
+  std::vector<std::unique_ptr<MPR121Manager>> managers;
+  for (unsigned n = 0; n < threads; n++) {
+    managers.emplace_back(new MPR121Manager(0x5A, portMask, &noBus));
+  }
+
+  // 全組み合わせを並列に評価
+  auto startTime = std::chrono::steady_clock::now();
+  std::vector<Result> results(candidates.size());
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (unsigned n = 0; n < threads; n++) {
+    workers.emplace_back([&, n]() {
+      for (size_t index; (index = next++) < candidates.size();) {
+        results[index] = evaluate(*managers[n], candidates[index], traces, minutes, options);
+      }
+    });
+  }
+  for (std::thread& worker : workers) worker.join();
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+  std::sort(results.begin(), results.end(), better);
+
+  printf("%zu traces, %zu scans, %.1f min; %zu configs on %u threads in %.2f s (%.1f M scans/s)\n", traces.size(), scans,
+         minutes, candidates.size(), threads, elapsed, scans * candidates.size() / elapsed / 1e6);
+  printf("%5s %4s %4s %4s %4s | %9s %7s %8s %8s %8s\n", "alpha", "tm", "rm", "tj", "rj", "detected", "false/m",
+         "touch", "touch90", "release");
+  for (size_t n = 0; n < results.size() && n < options.top; n++) {
+    const Result& r = results[n];
+    char detected[24];
+    snprintf(detected, sizeof(detected), "%zu/%zu", r.detected, r.labels);
+    printf("%5.2f %4d %4d %4d %4d | %9s %7.2f %6.1fms %6.1fms %6.1fms%s\n", r.candidate.alpha, r.candidate.touchMargin,
+           r.candidate.releaseMargin, r.candidate.touchJuge, r.candidate.releaseJuge, detected, r.falseTouches / minutes,
+           r.touchMean, r.touchP90, r.releaseMean, r.feasible ? "" : "  (over budget)");
+  }
+  if (results.empty()) return 1;
+
+  // 許容量を満たさない設定は、指定がない限り出力しない
+  if (!results[0].feasible) {
+    if (!options.allowInfeasible) {
+      fprintf(stderr, "error: no configuration meets the false-touch/miss budget (use --allow-infeasible 1 to write the closest)\n");
+      return 1;
+    }
+    fprintf(stderr, "warning: no configuration meets the false-touch/miss budget\n");
+  }
+
+  // 最良の組み合わせを設定データとして出力
+  uint8_t blob[MPR121Manager::configSize];
+  applyCandidate(*managers[0], results[0].candidate);
+  size_t size = managers[0]->saveConfig(blob, sizeof(blob));
+
+  printf("\nconst uint8_t mpr121Config[%zu] = {", size);
+  for (size_t n = 0; n < size; n++) printf("%s0x%02X", n % 12 ? ", " : (n ? ",\n  " : "\n  "), blob[n]);
+  printf("\n};  // manager.loadConfig(mpr121Config, sizeof(mpr121Config));\n");
+
+  if (!options.out.empty()) {
+    FILE* file = fopen(options.out.c_str(), "wb");
+    if (file == nullptr || fwrite(blob, 1, size, file) != size) {
+      fprintf(stderr, "cannot write: %s\n", options.out.c_str());
+      if (file != nullptr) fclose(file);
+      return 1;
+    }
+    fclose(file);
+  }
+  return 0;
+}